@@ -0,0 +1,200 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Discrete-event simulation of a task set, built for the hosted target with RTOS_SIMULATION (virtual time).
+// Every task of the scenario below is released periodically (sporadic tasks get a pseudo random extra delay),
+// runs a CPU burst of a given number of ticks and records its response time, i.e. the time from the release
+// to the end of the burst. A response longer than the deadline is a deadline miss.
+// After SIM_DURATION_SECONDS of virtual time the reporter prints the statistics of each task,
+// including the most stack it has ever used (the stacks are painted, see RTOS_GetStackHighWater())
+// and how long it took from the timer tick releasing a job to the job being dispatched (the wake-up latency).
+// The latency is stamped when the tick interrupt is entered, before the tick itself, so it is never less than one tick.
+// The latency histograms have power of two buckets in (virtual) nanoseconds, so the 99th percentile is an upper bound.
+// Time only passes in the bursts and jumps over idle periods, an hour is simulated in a few seconds,
+// and since nothing depends on the host every run prints exactly the same numbers.
+
+#include <stdint.h>
+#include <rtos.h>
+#include <board.h>
+#include "../utility.h"
+
+#if !defined(Board_SimulateCpuBurst)
+#error This example needs a target with virtual time (RTOS_SIMULATION), e.g. targets/posix.
+#endif
+
+#define SIM_STACK_SIZE	512
+
+struct sim_TaskSpec
+{
+	const char	*Name;
+	RTOS_Time	Period;		// Ticks between releases.
+	RTOS_Time	Jitter;		// Up to this many ticks are added to the period at random, 0 for a strictly periodic task.
+	RTOS_Time	Cost;		// The length of the CPU burst in ticks.
+	RTOS_Time	Deadline;	// Relative to the release.
+};
+
+// The scenario, in priority order (rate monotonic), the first task gets the highest priority.
+static const struct sim_TaskSpec sim_scenario[SIM_TASKS] =
+{
+	{ "control",	10,	0,	2,	10 },
+	{ "sensor",	25,	0,	4,	25 },
+	{ "comms",	40,	40,	9,	40 },
+	{ "ui",		100,	0,	20,	100 },
+	{ "logger",	250,	0,	55,	250 },
+};
+
+struct sim_TaskStatistics
+{
+	uint32_t	Jobs;
+	uint32_t	Misses;
+	RTOS_Time	MaxResponse;
+	uint64_t	TotalResponse;
+};
+
+RTOS_StackItem_t sim_stacks[SIM_TASKS][SIM_STACK_SIZE];
+RTOS_StackItem_t stack_reporter[SIM_STACK_SIZE];
+RTOS_StackItem_t stack_idle[RTOS_MIN_STACK_SIZE];
+
+RTOS_Task sim_tasks[SIM_TASKS];
+RTOS_Task task_reporter;
+RTOS_Task task_idle;
+
+struct sim_TaskStatistics sim_statistics[SIM_TASKS];
+volatile int sim_finished;
+
+// A simple linear congruential generator, seeded the same way in every run.
+static uint32_t sim_Random(uint32_t *state)
+{
+	*state = (*state * 1103515245U) + 12345U;
+	return *state >> 16;
+}
+
+void sim_Task(void *p)
+{
+	int i = (int)(intptr_t)p;
+	const struct sim_TaskSpec *spec = &sim_scenario[i];
+	struct sim_TaskStatistics *statistics = &sim_statistics[i];
+	uint32_t seed = (uint32_t)i + 1;
+	RTOS_Time release = RTOS_GetTime();
+	RTOS_Time response;
+
+	while(1)
+	{
+		// A job released while the previous one was still running starts right away.
+		if ((int32_t)(release - RTOS_GetTime()) > 0)
+		{
+			RTOS_DelayUntil(release);
+		}
+
+		if (sim_finished)
+		{
+			return;
+		}
+
+		Board_SimulateCpuBurst(spec->Cost);
+
+		response = RTOS_GetTime() - release;
+		statistics->Jobs++;
+		statistics->TotalResponse += response;
+
+		if (response > statistics->MaxResponse)
+		{
+			statistics->MaxResponse = response;
+		}
+
+		if (response > spec->Deadline)
+		{
+			statistics->Misses++;
+		}
+
+		release += spec->Period;
+
+		if (0 != spec->Jitter)
+		{
+			release += sim_Random(&seed) % (spec->Jitter + 1);
+		}
+	}
+}
+
+// The cycle counter of the simulation counts virtual nanoseconds.
+#define SIM_NS_PER_TICK	(1000000000UL / (RTOS_TICKS_PER_SECOND))
+
+static void sim_Print(const char *label, uint32_t value)
+{
+	Board_Puts(label);
+	PrintUnsignedDecimal(value);
+}
+
+void sim_Reporter(void *p)
+{
+	int i;
+	uint64_t total = (uint64_t)(SIM_DURATION_SECONDS) * 1000000000ULL;	// The run time is in (virtual) nanoseconds.
+	struct sim_TaskStatistics *statistics;
+	RTOS_LatencyStatistics latency;
+
+	RTOS_DelayUntil((RTOS_Time)(SIM_DURATION_SECONDS) * (RTOS_TICKS_PER_SECOND));
+
+	sim_Print("Simulated seconds: ", SIM_DURATION_SECONDS);
+	Board_Puts(", times are in ticks.\r\n");
+
+	for (i = 0; i < (SIM_TASKS); i++)
+	{
+		statistics = &sim_statistics[i];
+
+		Board_Puts(sim_scenario[i].Name);
+		sim_Print(": jobs: ", statistics->Jobs);
+		sim_Print("  deadline misses: ", statistics->Misses);
+		sim_Print("  response max: ", statistics->MaxResponse);
+		sim_Print("  average: ", (0 != statistics->Jobs) ? (uint32_t)(statistics->TotalResponse / statistics->Jobs) : 0);
+		sim_Print("  CPU %: ", (uint32_t)((RTOS_GetTaskRunTime(&sim_tasks[i]) * 100) / total));
+		sim_Print("  stack used: ", (uint32_t)RTOS_GetStackHighWater(&sim_tasks[i]));
+		sim_Print(" of ", SIM_STACK_SIZE);
+		RTOS_GetWakeupLatency(&sim_tasks[i], &latency);
+		sim_Print("  wake-up latency p99: ", latency.P99 / (SIM_NS_PER_TICK));
+		sim_Print("  max: ", latency.Max / (SIM_NS_PER_TICK));
+		Board_Puts("\r\n");
+	}
+
+	// The tasks return (and get killed) at their next release, once nothing is left to wake up the simulation ends.
+	sim_finished = 1;
+	(void)p;
+}
+
+int main()
+{
+	int i;
+
+	RTOS_CreateTask(&task_idle,     "Idle",     RTOS_Priority_Idle,        stack_idle,     RTOS_MIN_STACK_SIZE, &RTOS_DefaultIdleFunction, 0);
+	RTOS_CreateTask(&task_reporter, "Reporter", RTOS_Priority_SimReporter, stack_reporter, SIM_STACK_SIZE,      &sim_Reporter, 0);
+
+	for (i = 0; i < (SIM_TASKS); i++)
+	{
+		RTOS_CreateTask(&sim_tasks[i], sim_scenario[i].Name, (SIM_TASKS) - i, sim_stacks[i], SIM_STACK_SIZE, &sim_Task, (void *)(intptr_t)i);
+	}
+
+	Board_HardwareInit();
+	RTOS_StartMultitasking();
+	Board_Puts("Something has gone seriously wrong!\r\n");
+	while(1);
+	return 0;	// Unreachable.
+}
@@ -0,0 +1,317 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Measures how the SMP scheduler and the OS lock scale with the number of CPUs.
+// In round n, n workers run in parallel (one per CPU). Each does a bit of private work, then posts and gets its own
+// semaphore. The workers never wait for each other and the semaphores have locks of their own, so the OS lock is only
+// taken by the scheduler and the timer. Ideally the number of operations per second grows linearly with n;
+// the lock statistics show where that stops.
+// The ping-pong rounds exercise the slow path instead: workers are paired up on different CPUs and take turns,
+// each one blocks on its own semaphore (or queue) until its partner posts it, so every operation is a wake-up
+// of a task on another CPU.
+// The run time of each worker is printed as a percentage of the round, the way the kernel accounts it: on the
+// hosted target it still includes the time the host took the CPU thread away for something else.
+// Each round also reports the critical section that kept interrupts disabled the longest (see RTOS_GetCriticalSectionProfile()),
+// the site is the (low 32 bits of the) return address right after the RTOS_EnterCriticalSection() that opened it.
+// Meant for the hosted SMP target (targets/posix) with RTOS_SMP_CPU_CORES set to the number of CPUs to try.
+
+#include <stdint.h>
+#include <rtos.h>
+#include <rtos_queue.h>
+#include <board.h>
+#include "../utility.h"
+
+#define SCALE_WORKERS	(RTOS_SMP_CPU_CORES)
+#define SCALE_STACK_SIZE	512
+
+// How long a ping-pong worker waits for its partner before checking whether the round is over.
+#define SCALE_PING_TIMEOUT	((RTOS_TICKS_PER_SECOND) / 10)
+
+RTOS_StackItem_t scale_stacks[SCALE_WORKERS][SCALE_STACK_SIZE];
+RTOS_StackItem_t stack_reporter[SCALE_STACK_SIZE];
+RTOS_StackItem_t stack_idle[RTOS_MIN_STACK_SIZE];
+
+RTOS_Task scale_tasks[SCALE_WORKERS];
+RTOS_Task task_reporter;
+RTOS_Task task_idle;
+
+RTOS_Semaphore scale_semaphores[SCALE_WORKERS];
+RTOS_Queue scale_queues[SCALE_WORKERS];
+void *scale_queue_buffers[SCALE_WORKERS][1];
+volatile uint32_t scale_counters[SCALE_WORKERS];
+volatile int scale_stop;
+volatile int scale_use_queues;
+RTOS_RunTimeSnapshot scale_snapshot;
+RTOS_CriticalSectionSite scale_sites[RTOS_CRITICAL_PROFILE_SITES];
+
+static void scale_Work(void)
+{
+	volatile uint32_t work;
+	uint32_t j;
+
+	for (j = 0; j < (SCALE_WORK); j++)
+	{
+		work = j;
+	}
+	(void)work;
+}
+
+// Wait to be killed by the reporter.
+static void scale_Park(void)
+{
+	while (1)
+	{
+		RTOS_Delay(RTOS_TICKS_PER_SECOND);
+	}
+}
+
+void scale_Worker(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while (!scale_stop)
+	{
+		scale_Work();
+
+		RTOS_PostSemaphore(&scale_semaphores[i]);
+
+		if (RTOS_OK == RTOS_GetSemaphore(&scale_semaphores[i], 0))
+		{
+			scale_counters[i]++;
+		}
+	}
+
+	scale_Park();
+}
+
+// Hand the turn over to the partner of worker i.
+static void scale_Pass(int i)
+{
+	int partner = i ^ 1;
+
+	if (scale_use_queues)
+	{
+		RTOS_Enqueue(&scale_queues[partner], (void *)(intptr_t)i, SCALE_PING_TIMEOUT);
+	}
+	else
+	{
+		RTOS_PostSemaphore(&scale_semaphores[partner]);
+	}
+}
+
+// Worker i and its partner (i ^ 1) run on different CPUs and take turns, the even one starts.
+void scale_PingPongWorker(void *p)
+{
+	int i = (int)(intptr_t)p;
+	void *message;
+	RTOS_RegInt result;
+
+	if (0 == (i & 1))
+	{
+		scale_Pass(i);
+	}
+
+	while (!scale_stop)
+	{
+		if (scale_use_queues)
+		{
+			result = RTOS_Dequeue(&scale_queues[i], &message, SCALE_PING_TIMEOUT);
+		}
+		else
+		{
+			result = RTOS_GetSemaphore(&scale_semaphores[i], SCALE_PING_TIMEOUT);
+		}
+
+		if (RTOS_OK == result)
+		{
+			scale_counters[i]++;
+			scale_Work();
+			scale_Pass(i);
+		}
+	}
+
+	scale_Park();
+}
+
+static void scale_PrintLine(const char *label, uint32_t value)
+{
+	Board_Puts(label);
+	PrintUnsignedDecimal(value);
+}
+
+// Print the critical section of the round with the longest time interrupts were disabled.
+static void scale_PrintLongestCriticalSection(void)
+{
+	RTOS_RegUInt count;
+	RTOS_RegUInt i;
+	RTOS_RegUInt longest = 0;
+
+	count = RTOS_GetCriticalSectionProfile(scale_sites, RTOS_CRITICAL_PROFILE_SITES);
+
+	for (i = 1; i < count; i++)
+	{
+		if (scale_sites[i].MaxCycles > scale_sites[longest].MaxCycles)
+		{
+			longest = i;
+		}
+	}
+
+	if (0 != count)
+	{
+		scale_PrintLine("  longest critical section: ", scale_sites[longest].MaxCycles);
+		Board_Puts(" at ");
+		PrintHexNoCr((uint32_t)scale_sites[longest].Site);
+		scale_PrintLine(", entered ", scale_sites[longest].Count);
+		scale_PrintLine(" times, sites: ", (uint32_t)count);
+		scale_PrintLine(", dropped: ", RTOS_GetCriticalSectionProfileDropped());
+		Board_Puts("\r\n");
+	}
+}
+
+// Run n workers, worker i pinned to CPU i, for SCALE_ROUND_SECONDS and print the results.
+static void scale_RunRound(int n, void (*worker)(void *))
+{
+	int i;
+	RTOS_CpuId cpu;
+	uint32_t total;
+	uint64_t spinCycles;
+	uint32_t spinCount;
+	uint32_t spinMax;
+	RTOS_LockSpinStatistics spin;
+	RTOS_CycleCount start;
+	RTOS_SavedCriticalState(saved_state);
+
+	scale_stop = 0;
+	RTOS_ResetCriticalSectionProfile();
+	RTOS_GetRunTimeSnapshot(&scale_snapshot);
+	start = scale_snapshot.Timestamp;
+
+	for (i = 0; i < n; i++)
+	{
+		scale_counters[i] = 0;
+		RTOS_CreateSemaphore(&scale_semaphores[i], 0);
+		RTOS_CreateQueue(&scale_queues[i], scale_queue_buffers[i], 1);
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		// Tasks are created while the OS is running, so it must be done in a critical section.
+		RTOS_EnterCriticalSection(saved_state);
+		RTOS_CreateTask(&scale_tasks[i], "Worker", RTOS_Priority_Worker0 + i,
+				scale_stacks[i], SCALE_STACK_SIZE, worker, (void *)(intptr_t)i);
+		RTOS_RestrictTaskToCpus(&scale_tasks[i], RTOS_CpuMask_AddCpu((RTOS_CpuMask)0, i));
+		RTOS_ExitCriticalSection(saved_state);
+	}
+
+	RTOS_Delay((RTOS_Time)(SCALE_ROUND_SECONDS) * (RTOS_TICKS_PER_SECOND));
+
+	// A task running on another CPU cannot be killed, the workers stop and go to sleep first.
+	// Give the ping-pong workers time to give up waiting for their partners.
+	scale_stop = 1;
+	RTOS_Delay(2 * (SCALE_PING_TIMEOUT));
+
+	// The workers are asleep now, so their run time is up to date. It is gone once they are killed.
+	RTOS_GetRunTimeSnapshot(&scale_snapshot);
+
+	for (i = 0; i < n; i++)
+	{
+		while (RTOS_OK != RTOS_KillTask(&scale_tasks[i]))
+		{
+			RTOS_Delay(1);
+		}
+	}
+
+	total = 0;
+	for (i = 0; i < n; i++)
+	{
+		total += scale_counters[i];
+	}
+
+	spinCycles = 0;
+	spinCount = 0;
+	spinMax = 0;
+	for (cpu = 0; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+	{
+		if (RTOS_OK == RTOS_GetLockSpinStatistics(cpu, &spin))
+		{
+			spinCycles += spin.TotalCycles;
+			spinCount += spin.Count;
+			if (spin.MaxCycles > spinMax)
+			{
+				spinMax = spin.MaxCycles;
+			}
+		}
+	}
+
+	scale_PrintLine("CPUs: ", (uint32_t)n);
+	scale_PrintLine("  ops/s: ", total / (SCALE_ROUND_SECONDS));
+	scale_PrintLine("  locks/s: ", spinCount / (SCALE_ROUND_SECONDS));
+	scale_PrintLine("  average wait: ", (0 != spinCount) ? (uint32_t)(spinCycles / spinCount) : 0);
+	scale_PrintLine("  longest wait: ", spinMax);
+	Board_Puts("  run time %:");
+	for (i = 0; i < n; i++)
+	{
+		scale_PrintLine(" ", (uint32_t)((scale_snapshot.TaskRunTime[RTOS_Priority_Worker0 + i] * 100) / (scale_snapshot.Timestamp - start)));
+	}
+	Board_Puts("\r\n");
+	scale_PrintLongestCriticalSection();
+}
+
+// Run a round with 1, 2, ... RTOS_SMP_CPU_CORES workers, then the ping-pong rounds with 1, 2, ... pairs.
+void scale_Reporter(void *p)
+{
+	int n;
+
+	while(1)
+	{
+		Board_Puts("\r\nSMP scaling, operations per second and OS lock waits (in cycle counter units):\r\n");
+
+		for (n = 1; n <= (SCALE_WORKERS); n++)
+		{
+			scale_RunRound(n, &scale_Worker);
+		}
+
+		for (scale_use_queues = 0; scale_use_queues <= 1; scale_use_queues++)
+		{
+			Board_Puts(scale_use_queues ? "Ping-pong across CPUs, queues:\r\n" : "Ping-pong across CPUs, semaphores:\r\n");
+
+			for (n = 2; n <= (SCALE_WORKERS); n += 2)
+			{
+				scale_RunRound(n, &scale_PingPongWorker);
+			}
+		}
+	}
+	(void)p;
+}
+
+int main()
+{
+	RTOS_CreateTask(&task_idle,     "Idle",     RTOS_Priority_Idle,     stack_idle,     RTOS_MIN_STACK_SIZE, &RTOS_DefaultIdleFunction, 0);
+	RTOS_CreateTask(&task_reporter, "Reporter", RTOS_Priority_Reporter, stack_reporter, SCALE_STACK_SIZE,    &scale_Reporter, 0);
+
+	Board_HardwareInit();
+	RTOS_StartMultitasking();
+	Board_Puts("Something has gone seriously wrong!\r\n");
+	while(1);
+	return 0;	// Unreachable.
+}
@@ -0,0 +1,68 @@
+#ifndef RTOS_CONFIG_H
+#define RTOS_CONFIG_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTOS_INCLUDE_SEMAPHORES
+#define RTOS_INCLUDE_DELAY
+#define RTOS_INCLUDE_KILLTASK
+#define RTOS_INCLUDE_WAKEUP	// Killing a sleeping task wakes it up first.
+
+// Time spent waiting for the OS lock is reported by RTOS_GetLockSpinStatistics(),
+// the longest critical sections by RTOS_GetCriticalSectionProfile().
+#define RTOS_INCLUDE_CRITICAL_PROFILING
+
+// How much of each round the workers actually ran.
+#define RTOS_INCLUDE_RUNTIME_ACCOUNTING
+
+#define RTOS_SMP
+#define RTOS_SUPPORT_TIMESHARE	// The SMP code uses the timeshare data structures.
+#if !defined(RTOS_SMP_CPU_CORES)
+#define RTOS_SMP_CPU_CORES	4
+#endif
+
+#define RTOS_TASK_NAME_LENGTH	32
+
+#define RTOS_TICKS_PER_SECOND 	100
+
+// How long each round runs.
+#define SCALE_ROUND_SECONDS	5
+
+// Iterations of the busy loop between two OS calls, this is the 'parallel' part of the work.
+#define SCALE_WORK	200
+
+// One worker per CPU at priorities 1 .. RTOS_SMP_CPU_CORES, the reporter preempts all of them.
+#define RTOS_Priority_Worker0	1
+#define RTOS_Priority_Reporter	((RTOS_SMP_CPU_CORES) + 1)
+
+// RTOS_Priority_Highest must be defined and it must be equal to the highest priority ever used by the application.
+#define RTOS_Priority_Highest    RTOS_Priority_Reporter
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
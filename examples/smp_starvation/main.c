@@ -0,0 +1,148 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Regression test for tasks starving in the run queue of a parked CPU.
+// Two CPUs: the low priority task may run anywhere, the medium and high priority tasks prefer CPU 1.
+// CPU 1 does not exist yet when CPU 0 makes its first scheduling decision.
+// The tasks never block, so with two CPUs the medium and high priority tasks must be running nearly all the time,
+// the reporter checks that every second. The low priority task may still run for a moment now and then, while a task
+// preempted by the reporter waits for its preferred CPU to pick it up.
+// Before this was fixed CPU 0 did not take the tasks queued for CPU 1 and CPU 1 was never told about them,
+// so it stayed parked in the holding pen while CPU 0 ran the low priority task forever. The reporter only runs
+// on CPU 1, so in that case it has nothing to say, the low priority task reports the failure itself.
+// Meant for the hosted SMP target (targets/posix).
+
+#include <stdint.h>
+#include <rtos.h>
+#include <board.h>
+#include "../utility.h"
+
+#define STARVE_TASKS		3
+#define STARVE_STACK_SIZE	512
+
+// How often the low priority task checks the others (a power of two, in loops).
+#define STARVE_CHECK		(1UL << 24)
+
+RTOS_StackItem_t starve_stacks[STARVE_TASKS][STARVE_STACK_SIZE];
+RTOS_StackItem_t stack_reporter[STARVE_STACK_SIZE];
+RTOS_StackItem_t stack_idle[RTOS_MIN_STACK_SIZE];
+
+RTOS_Task starve_tasks[STARVE_TASKS];
+RTOS_Task task_reporter;
+RTOS_Task task_idle;
+
+volatile uint32_t starve_counters[STARVE_TASKS];
+
+static const char *starve_names[STARVE_TASKS] = { "Low", "Medium", "High" };
+static const RTOS_TaskPriority starve_priorities[STARVE_TASKS] = { RTOS_Priority_Low, RTOS_Priority_Medium, RTOS_Priority_High };
+
+void starve_Task(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while (1)
+	{
+		starve_counters[i]++;
+	}
+}
+
+// The low priority task should hardly ever run, if it does for long it checks whether the others are still running.
+void starve_LowTask(void *p)
+{
+	uint32_t medium = 0;
+	uint32_t high = 0;
+
+	while (1)
+	{
+		if (0 == (++starve_counters[0] & ((STARVE_CHECK) - 1)))
+		{
+			if ((medium == starve_counters[1]) || (high == starve_counters[2]))
+			{
+				Board_Puts("Low is running while Medium or High is not  FAILED\r\n");
+			}
+			medium = starve_counters[1];
+			high = starve_counters[2];
+		}
+	}
+	(void)p;
+}
+
+void starve_Reporter(void *p)
+{
+	int i;
+	uint32_t previous[STARVE_TASKS] = { 0 };
+	uint32_t counts[STARVE_TASKS];
+	uint32_t now;
+
+	while (1)
+	{
+		RTOS_Delay(RTOS_TICKS_PER_SECOND);
+
+		for (i = 0; i < (STARVE_TASKS); i++)
+		{
+			now = starve_counters[i];
+			counts[i] = now - previous[i];
+			previous[i] = now;
+
+			Board_Puts(starve_names[i]);
+			Board_Puts(": ");
+			PrintUnsignedDecimal(counts[i]);
+			Board_Puts("  ");
+		}
+
+		// Loops per second, the low priority task must not get more than a fraction of what the others get.
+		if ((0 == counts[1]) || (0 == counts[2]) || (counts[0] > counts[1] / 10) || (counts[0] > counts[2] / 10))
+		{
+			Board_Puts(" FAILED\r\n");
+		}
+		else
+		{
+			Board_Puts(" OK\r\n");
+		}
+	}
+	(void)p;
+}
+
+int main()
+{
+	int i;
+
+	RTOS_CreateTask(&task_idle,     "Idle",     RTOS_Priority_Idle,     stack_idle,     RTOS_MIN_STACK_SIZE, &RTOS_DefaultIdleFunction, 0);
+	RTOS_CreateTask(&task_reporter, "Reporter", RTOS_Priority_Reporter, stack_reporter, STARVE_STACK_SIZE,   &starve_Reporter, 0);
+
+	for (i = 0; i < (STARVE_TASKS); i++)
+	{
+		RTOS_CreateTask(&starve_tasks[i], starve_names[i], starve_priorities[i],
+				starve_stacks[i], STARVE_STACK_SIZE, (0 == i) ? &starve_LowTask : &starve_Task, (void *)(intptr_t)i);
+	}
+
+	RTOS_SetPreferredCpu(&starve_tasks[1], 1);
+	RTOS_SetPreferredCpu(&starve_tasks[2], 1);
+	RTOS_RestrictTaskToCpus(&task_reporter, RTOS_CpuMask_AddCpu((RTOS_CpuMask)0, 1));
+
+	Board_HardwareInit();
+	RTOS_StartMultitasking();
+	Board_Puts("Something has gone seriously wrong!\r\n");
+	while(1);
+	return 0;	// Unreachable.
+}
@@ -0,0 +1,320 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// A benchmark in the spirit of the Thread-Metric RTOS test suite.
+// Each test runs for TM_TEST_DURATION_SECONDS while a high priority reporter task sleeps,
+// then the reporter kills the test tasks and prints the number of operations per second.
+// The tests run one after the other, then the whole sequence starts again.
+//
+// cooperative:  5 tasks round robin with RTOS_YieldPriority(), an operation is one yield.
+// preemptive:   5 tasks, each resumes the next higher priority one, the highest suspends itself.
+// interrupt:    a task raises a software interrupt, the ISR posts a semaphore which the task then gets.
+// message:      a task sends a message to a queue and receives it back.
+// semaphore:    a task gets and posts a semaphore.
+// memory:       a task allocates a 128 byte block from a pool and frees it.
+//
+// Unlike Thread-Metric the message test passes pointers (that is what RTOS_Queue holds), not 16 byte messages.
+//
+// On targets that define RTOS_READ_CACHE_MISS_COUNTER() the cache misses per operation are printed as well
+// (counted on the reporter's CPU, which is the only CPU in this configuration).
+
+#include <stdint.h>
+#include <rtos.h>
+#include <rtos_queue.h>
+#include <rtos_mempool.h>
+#include <board.h>
+#include "../utility.h"
+
+#define TM_TASKS	5
+#define TM_STACK_SIZE	512
+#define TM_BLOCK_SIZE	128
+#define TM_BLOCKS	8
+
+RTOS_StackItem_t tm_stacks[TM_TASKS][TM_STACK_SIZE];
+RTOS_StackItem_t stack_reporter[TM_STACK_SIZE];
+RTOS_StackItem_t stack_idle[RTOS_MIN_STACK_SIZE];
+
+RTOS_Task tm_tasks[TM_TASKS];
+RTOS_Task task_reporter;
+RTOS_Task task_idle;
+
+volatile uint32_t tm_counters[TM_TASKS];
+int tm_tasks_created;
+
+RTOS_Semaphore tm_semaphore;
+RTOS_Queue tm_queue;
+void *tm_queue_buffer[4];
+RTOS_MemoryPool tm_pool;
+uint32_t tm_pool_buffer[(TM_BLOCK_SIZE * TM_BLOCKS) / sizeof(uint32_t)];
+
+// Tasks are created while the OS is running, so it must be done in a critical section.
+static void tm_CreateTask(void (*f)(void *))
+{
+	RTOS_SavedCriticalState(saved_state);
+
+	RTOS_EnterCriticalSection(saved_state);
+	RTOS_CreateTask(&tm_tasks[tm_tasks_created], "TM", RTOS_Priority_TM_Task0 + tm_tasks_created,
+			tm_stacks[tm_tasks_created], TM_STACK_SIZE, f, (void *)(intptr_t)tm_tasks_created);
+	RTOS_ExitCriticalSection(saved_state);
+	tm_tasks_created++;
+}
+
+// ---------------------------------------------------------------------------------------------
+void tm_Cooperative(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while(1)
+	{
+		tm_counters[i]++;
+		RTOS_YieldPriority();
+	}
+}
+
+static void tm_CooperativeSetup(void)
+{
+	int i;
+
+	for (i = 0; i < TM_TASKS; i++)
+	{
+		tm_CreateTask(&tm_Cooperative);
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+void tm_Preemptive(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while(1)
+	{
+		if (0 != i)
+		{
+			RTOS_SuspendSelf();
+		}
+
+		tm_counters[i]++;
+
+		if (i < (TM_TASKS - 1))
+		{
+			RTOS_ResumeTask(&tm_tasks[i + 1]);
+		}
+	}
+}
+
+static void tm_PreemptiveSetup(void)
+{
+	int i;
+
+	for (i = 0; i < TM_TASKS; i++)
+	{
+		tm_CreateTask(&tm_Preemptive);
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+#if defined(Board_RaiseSoftwareInterrupt)
+void tm_InterruptHandler(void)
+{
+	RTOS_PostSemaphore(&tm_semaphore);
+}
+
+void tm_Interrupt(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while(1)
+	{
+		Board_RaiseSoftwareInterrupt();
+
+		if (RTOS_OK == RTOS_GetSemaphore(&tm_semaphore, 0))
+		{
+			tm_counters[i]++;
+		}
+	}
+}
+
+static void tm_InterruptSetup(void)
+{
+	RTOS_CreateSemaphore(&tm_semaphore, 0);
+	Board_SoftwareInterruptHook = &tm_InterruptHandler;
+	tm_CreateTask(&tm_Interrupt);
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+void tm_Message(void *p)
+{
+	int i = (int)(intptr_t)p;
+	void *message = 0;
+
+	while(1)
+	{
+		RTOS_Enqueue(&tm_queue, (void *)(uintptr_t)(tm_counters[i]), 0);
+
+		if (RTOS_OK == RTOS_Dequeue(&tm_queue, &message, 0))
+		{
+			tm_counters[i]++;
+		}
+	}
+}
+
+static void tm_MessageSetup(void)
+{
+	RTOS_CreateQueue(&tm_queue, tm_queue_buffer, sizeof(tm_queue_buffer) / sizeof(tm_queue_buffer[0]));
+	tm_CreateTask(&tm_Message);
+}
+
+// ---------------------------------------------------------------------------------------------
+void tm_Semaphore(void *p)
+{
+	int i = (int)(intptr_t)p;
+
+	while(1)
+	{
+		if (RTOS_OK == RTOS_GetSemaphore(&tm_semaphore, 0))
+		{
+			tm_counters[i]++;
+		}
+
+		RTOS_PostSemaphore(&tm_semaphore);
+	}
+}
+
+static void tm_SemaphoreSetup(void)
+{
+	RTOS_CreateSemaphore(&tm_semaphore, 1);
+	tm_CreateTask(&tm_Semaphore);
+}
+
+// ---------------------------------------------------------------------------------------------
+void tm_Memory(void *p)
+{
+	int i = (int)(intptr_t)p;
+	void *block;
+
+	while(1)
+	{
+		if (RTOS_OK == RTOS_AllocateBlock(&tm_pool, &block, 0))
+		{
+			tm_counters[i]++;
+			RTOS_FreeBlock(&tm_pool, block);
+		}
+	}
+}
+
+static void tm_MemorySetup(void)
+{
+	RTOS_CreateMemoryPool(&tm_pool, tm_pool_buffer, TM_BLOCK_SIZE, TM_BLOCKS);
+	tm_CreateTask(&tm_Memory);
+}
+
+// ---------------------------------------------------------------------------------------------
+struct tm_Test
+{
+	const char *Name;
+	void (*Setup)(void);
+};
+
+static const struct tm_Test tm_tests[] =
+{
+	{ "cooperative scheduling: ",	&tm_CooperativeSetup },
+	{ "preemptive scheduling:  ",	&tm_PreemptiveSetup },
+#if defined(Board_RaiseSoftwareInterrupt)
+	{ "interrupt processing:   ",	&tm_InterruptSetup },
+#endif
+	{ "message processing:     ",	&tm_MessageSetup },
+	{ "semaphore processing:   ",	&tm_SemaphoreSetup },
+	{ "memory allocation:      ",	&tm_MemorySetup },
+};
+
+// Run each test in turn and print the results.
+void tm_Reporter(void *p)
+{
+	unsigned int t;
+	int i;
+	uint32_t total;
+#if defined(RTOS_READ_CACHE_MISS_COUNTER)
+	uint32_t misses;
+#endif
+
+	while(1)
+	{
+		Board_Puts("\r\nThread-Metric style benchmark, operations per second:\r\n");
+
+		for (t = 0; t < (sizeof(tm_tests) / sizeof(tm_tests[0])); t++)
+		{
+			for (i = 0; i < TM_TASKS; i++)
+			{
+				tm_counters[i] = 0;
+			}
+
+			tm_tasks_created = 0;
+#if defined(RTOS_READ_CACHE_MISS_COUNTER)
+			misses = RTOS_READ_CACHE_MISS_COUNTER();
+#endif
+			tm_tests[t].Setup();
+
+			RTOS_Delay((RTOS_Time)(TM_TEST_DURATION_SECONDS) * (RTOS_TICKS_PER_SECOND));
+
+			total = 0;
+			for (i = 0; i < tm_tasks_created; i++)
+			{
+				RTOS_KillTask(&tm_tasks[i]);
+				total += tm_counters[i];
+			}
+
+#if defined(RTOS_READ_CACHE_MISS_COUNTER)
+			misses = RTOS_READ_CACHE_MISS_COUNTER() - misses;
+#endif
+
+#if defined(Board_RaiseSoftwareInterrupt)
+			Board_SoftwareInterruptHook = 0;
+#endif
+
+			Board_Puts(tm_tests[t].Name);
+			PrintUnsignedDecimal(total / (TM_TEST_DURATION_SECONDS));
+#if defined(RTOS_READ_CACHE_MISS_COUNTER)
+			if ((0 != misses) && (0 != total))
+			{
+				Board_Puts("  cache misses per 100 operations: ");
+				PrintUnsignedDecimal((uint32_t)(((uint64_t)misses * 100) / total));
+			}
+#endif
+			Board_Puts("\r\n");
+		}
+	}
+	(void)p;
+}
+
+int main()
+{
+	RTOS_CreateTask(&task_idle,     "Idle",     RTOS_Priority_Idle,        stack_idle,     RTOS_MIN_STACK_SIZE, &RTOS_DefaultIdleFunction, 0);
+	RTOS_CreateTask(&task_reporter, "Reporter", RTOS_Priority_TM_Reporter, stack_reporter, TM_STACK_SIZE,       &tm_Reporter, 0);
+
+	Board_HardwareInit();
+	RTOS_StartMultitasking();
+	Board_Puts("Something has gone seriously wrong!\r\n");
+	while(1);
+	return 0;	// Unreachable.
+}
@@ -0,0 +1,122 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#include <stdint.h>
+#include <rtos.h>
+#include <rtos_mempool.h>
+
+RTOS_RegInt RTOS_CreateMemoryPool(RTOS_MemoryPool *pool, void *buffer, unsigned long blockSize, RTOS_SemaphoreCount count)
+{
+	RTOS_SemaphoreCount i;
+	uint8_t *block;
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != pool);
+	RTOS_ASSERT(0 != buffer);
+	RTOS_ASSERT(0 != count);
+	RTOS_ASSERT(blockSize >= sizeof(void *));
+	RTOS_ASSERT(0 == (blockSize % sizeof(void *)));
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if ((0 == pool) || (0 == buffer) || (0 == count) || (blockSize < sizeof(void *)) || (0 != (blockSize % sizeof(void *))))
+	{
+		return  RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	// Thread all blocks onto the free list, the first block ends up at the head.
+	pool->FreeList = 0;
+	block = (uint8_t *)buffer + (unsigned long)(count - 1) * blockSize;
+
+	for (i = 0; i < count; i++)
+	{
+		*(void **)block = pool->FreeList;
+		pool->FreeList = block;
+		block -= blockSize;
+	}
+
+	pool->BlockSize = blockSize;
+	pool->BlockCount = count;
+
+	return RTOS_CreateSemaphore(&(pool->SemFreeBlocks), count);
+}
+
+RTOS_RegInt RTOS_AllocateBlock(RTOS_MemoryPool *pool, void **block, RTOS_Time timeout)
+{
+	RTOS_RegInt result;
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != pool);
+	RTOS_ASSERT(0 != block);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if ((0 == pool) || (0 == block))
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	if ((0 != timeout) && (0 != RTOS_IsInsideIsr()))
+	{
+		return RTOS_ERROR_FAILED;
+	}
+
+	result = RTOS_GetSemaphore(&(pool->SemFreeBlocks), timeout);
+
+	if (RTOS_OK == result)
+	{
+		RTOS_EnterCriticalSection(saved_state);
+		*block = pool->FreeList;
+		pool->FreeList = *(void **)(pool->FreeList);
+		RTOS_ExitCriticalSection(saved_state);
+	}
+
+	return result;
+}
+
+RTOS_RegInt RTOS_FreeBlock(RTOS_MemoryPool *pool, void *block)
+{
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != pool);
+	RTOS_ASSERT(0 != block);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if ((0 == pool) || (0 == block))
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	*(void **)block = pool->FreeList;
+	pool->FreeList = block;
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_PostSemaphore(&(pool->SemFreeBlocks));
+}
@@ -0,0 +1,51 @@
+#ifndef RTOS_MEMPOOL_H
+#define RTOS_MEMPOOL_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rtos.h>
+
+struct rtos_MemoryPool	// A pool of fixed size memory blocks.
+{
+	RTOS_Semaphore  SemFreeBlocks;	// Semaphore counting free blocks.
+	void		*FreeList;	// Free blocks are linked through their first word.
+	unsigned long	BlockSize;
+	RTOS_SemaphoreCount BlockCount;
+};
+
+typedef struct rtos_MemoryPool RTOS_MemoryPool;
+
+// The buffer must hold count blocks of blockSize bytes, blockSize must be a multiple of sizeof(void *).
+extern RTOS_RegInt RTOS_CreateMemoryPool(RTOS_MemoryPool *pool, void *buffer, unsigned long blockSize, RTOS_SemaphoreCount count);
+extern RTOS_RegInt RTOS_AllocateBlock(RTOS_MemoryPool *pool, void **block, RTOS_Time timeout);
+extern RTOS_RegInt RTOS_FreeBlock(RTOS_MemoryPool *pool, void *block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
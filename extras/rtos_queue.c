@@ -21,6 +21,7 @@
 *
 */
 #include <rtos_queue.h>
+#include <rtos_internals.h>
 
 RTOS_RegInt RTOS_CreateQueue(RTOS_Queue *queue, void *buffer, RTOS_QueueCount size)
 {
@@ -40,6 +41,9 @@ RTOS_RegInt RTOS_CreateQueue(RTOS_Queue *queue, void *buffer, RTOS_QueueCount si
 
 	queue->Head = 0;
 	queue->Tail = 0;
+#if defined(RTOS_SMP)
+	queue->Lock = 0;
+#endif
 	result = RTOS_CreateSemaphore(&(queue->SemFilledSlots), 0);
 	result = RTOS_CreateSemaphore(&(queue->SemEmptySlots), size);
 
@@ -94,7 +98,7 @@ RTOS_RegInt RTOS_Enqueue(RTOS_Queue *queue, void *message, RTOS_Time timeout)
 	if (RTOS_OK == result)
 	{
 
-		RTOS_EnterCriticalSection(saved_state);
+		rtos_EnterObjectLock(&(queue->Lock), saved_state);
 
 		// Check if the queue was destroyed by another thread after the GetSempahore() operation.
 		if ((0 == queue->Size) || (0 == queue->Buffer))
@@ -103,11 +107,12 @@ RTOS_RegInt RTOS_Enqueue(RTOS_Queue *queue, void *message, RTOS_Time timeout)
 		}
 		else
 		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_QUEUE_ENQUEUE, queue->Tail, queue);
 			queue->Buffer[queue->Tail] = message;
 			queue->Tail = rtos_NextIndexInQueue(queue, queue->Tail);
 		}
 
-		RTOS_ExitCriticalSection(saved_state);
+		rtos_ExitObjectLock(&(queue->Lock), saved_state);
 	}
 
 	if (RTOS_OK == result)
@@ -144,7 +149,7 @@ RTOS_RegInt RTOS_PrependQueue(RTOS_Queue *queue, void *message, RTOS_Time timeou
 	if (RTOS_OK == result)
 	{
 
-		RTOS_EnterCriticalSection(saved_state);
+		rtos_EnterObjectLock(&(queue->Lock), saved_state);
 
 		// Check if the queue was destroyed by another thread after the GetSempahore() operation.
 		if ((0 == queue->Size) || (0 == queue->Buffer))
@@ -162,9 +167,10 @@ RTOS_RegInt RTOS_PrependQueue(RTOS_Queue *queue, void *message, RTOS_Time timeou
 				queue->Head -= 1;
 			}
 			queue->Buffer[queue->Head] = message;
+			RTOS_TRACE(RTOS_TRACE_EVENT_QUEUE_PREPEND, queue->Head, queue);
 		}
 
-		RTOS_ExitCriticalSection(saved_state);
+		rtos_ExitObjectLock(&(queue->Lock), saved_state);
 	}
 
 	if (RTOS_OK == result)
@@ -201,7 +207,7 @@ RTOS_RegInt RTOS_Dequeue(RTOS_Queue *queue, void **message, RTOS_Time timeout)
 
 	if (RTOS_OK == result)
 	{
-		RTOS_EnterCriticalSection(saved_state);
+		rtos_EnterObjectLock(&(queue->Lock), saved_state);
 
 		// Check if the queue was destroyed by another thread after the GetSempahore() operation.
 		if ((0 == queue->Size) || (0 == queue->Buffer))
@@ -210,11 +216,12 @@ RTOS_RegInt RTOS_Dequeue(RTOS_Queue *queue, void **message, RTOS_Time timeout)
 		}
 		else
 		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_QUEUE_DEQUEUE, queue->Head, queue);
 			*message = queue->Buffer[queue->Head];
 			queue->Head = rtos_NextIndexInQueue(queue, queue->Head);
 		}
 
-		RTOS_ExitCriticalSection(saved_state);
+		rtos_ExitObjectLock(&(queue->Lock), saved_state);
 	}
 
 	if (RTOS_OK == result)
@@ -242,7 +249,7 @@ RTOS_RegInt RTOS_PeekQueue(RTOS_Queue *queue, void **message)
 	}
 #endif
 		
-	RTOS_EnterCriticalSection(saved_state);
+	rtos_EnterObjectLock(&(queue->Lock), saved_state);
 
 	if ((0 == queue->Size) || (0 == queue->Buffer))
 	{
@@ -257,12 +264,13 @@ RTOS_RegInt RTOS_PeekQueue(RTOS_Queue *queue, void **message)
 		}
 		else
 		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_QUEUE_PEEK, queue->Head, queue);
 			*message = queue->Buffer[queue->Head];
 			result = RTOS_OK;
 		}
 	}
 
-	RTOS_ExitCriticalSection(saved_state);
+	rtos_ExitObjectLock(&(queue->Lock), saved_state);
 
 	return result;
 }
@@ -283,7 +291,7 @@ RTOS_RegInt RTOS_DestroyQueue(RTOS_Queue *queue)
 	}
 #endif
 
-	RTOS_EnterCriticalSection(saved_state);
+	rtos_EnterObjectLock(&(queue->Lock), saved_state);
 	
 	if (0 != RTOS_PeekSemaphore(&(queue->SemFilledSlots)))
 	{
@@ -296,7 +304,7 @@ RTOS_RegInt RTOS_DestroyQueue(RTOS_Queue *queue)
 		result = RTOS_OK;
 	}
 
-	RTOS_ExitCriticalSection(saved_state);
+	rtos_ExitObjectLock(&(queue->Lock), saved_state);
 
 	return result;
 }
@@ -41,6 +41,9 @@ struct rtos_Queue	// A FIFO (Queue or message queue).
 	RTOS_QueueCount Head;
 	RTOS_QueueCount Tail;
 	void **Buffer;
+#if defined(RTOS_SMP)
+	RTOS_CpuMutex	Lock;		// Protects Head, Tail and Buffer from other CPUs.
+#endif
 };
 
 typedef struct rtos_Queue RTOS_Queue;
@@ -112,6 +112,12 @@ void rtos_debug_PrintTask(const RTOS_Task *task)
 	rtos_debug_PrintStrPadded("SP:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex((uint32_t)(task->SP), 0);
 	rtos_debug_PrintStr(" Ret: "); rtos_debug_PrintHex(RTOS_TASK_EXEC_LOCATION(task), 1);
 	rtos_debug_PrintStrPadded("SP0:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex((uint32_t)(task->SP0), 1);
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+	rtos_debug_PrintStrPadded("Stack (capacity, max. used):",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->StackCapacity, 0); rtos_debug_PrintHex(RTOS_GetStackHighWater((RTOS_Task *)task), 1);
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_debug_PrintStrPadded("Wakeup latency (count, min, max):",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->WakeupLatency.Count, 0); rtos_debug_PrintHex(task->WakeupLatency.Min, 0); rtos_debug_PrintHex(task->WakeupLatency.Max, 1);
+#endif
 	rtos_debug_PrintStrPadded("Priority:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->Priority, 1);
 
 	rtos_debug_PrintStrPadded("WaitFor:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex((uint32_t)(task->WaitFor), 1);
@@ -132,6 +138,8 @@ void rtos_debug_PrintTask(const RTOS_Task *task)
 #endif
 #if defined(RTOS_SMP)
 	rtos_debug_PrintStrPadded("Cpu:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->Cpu, 1);
+	rtos_debug_PrintStrPadded("HomeCpu:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->HomeCpu, 1);
+	rtos_debug_PrintStrPadded("PreferredCpu:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->PreferredCpu, 1);
 #endif
 	rtos_debug_PrintStrPadded("Status:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(task->Status, 1);
 #if defined(RTOS_TARGET_SPECIFIC_TASK_DATA)
@@ -168,7 +176,7 @@ void rtos_debug_PrintOS(void)
 #if defined(RTOS_SMP)
 	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
 	{
-		rtos_debug_PrintHex(RTOS.InterruptNesting[i], 0);
+		rtos_debug_PrintHex(RTOS.PerCpu[i].InterruptNesting, 0);
 	}
 	rtos_debug_putchar('\n');
 #else
@@ -186,6 +194,13 @@ void rtos_debug_PrintOS(void)
 
 	rtos_debug_PrintStrPadded("OSLock:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS.OSLock, 1);
 	rtos_debug_PrintStrPadded("RunningTasks:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS.RunningTasks, 1);
+	rtos_debug_PrintStrPadded("CpuTasks:",RTOS_FIELD_WIDTH);
+	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
+	{
+		rtos_debug_PrintHex(RTOS.CpuTasks[i], 0);
+	}
+	rtos_debug_putchar('\n');
+	rtos_debug_PrintStrPadded("QueuedTasks:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS.QueuedTasks, 1);
 	rtos_debug_PrintStrPadded("Cpus:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS.Cpus, 1);
 	rtos_debug_PrintStrPadded("CpuHoldingPen:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS.CpuHoldingPen, 1);
 #endif
@@ -216,13 +231,49 @@ void rtos_debug_PrintOS(void)
 #if defined(RTOS_SMP)
 	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
 	{
-		rtos_debug_PrintTask(RTOS.CurrentTasks[i]);
+		rtos_debug_PrintTask(RTOS.PerCpu[i].CurrentTask);
 	}
 #else
 	rtos_debug_PrintTask(RTOS.CurrentTask);
 #endif
 }
 
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+// Print the call sites of critical sections with the longest time each kept interrupts disabled.
+void rtos_debug_PrintCriticalSections(void)
+{
+	RTOS_CriticalSectionSite sites[RTOS_CRITICAL_PROFILE_SITES];
+	RTOS_RegUInt count;
+	RTOS_RegUInt i;
+#if defined(RTOS_SMP)
+	RTOS_LockSpinStatistics spin;
+#endif
+
+	count = RTOS_GetCriticalSectionProfile(sites, RTOS_CRITICAL_PROFILE_SITES);
+
+	rtos_debug_PrintStr("\nCritical sections (site max count):\n");
+	for (i = 0; i < count; i++)
+	{
+		rtos_debug_PrintHex(sites[i].Site, 0);
+		rtos_debug_PrintHex(sites[i].MaxCycles, 0);
+		rtos_debug_PrintHex(sites[i].Count, 1);
+	}
+	rtos_debug_PrintStrPadded("Dropped:",RTOS_FIELD_WIDTH); rtos_debug_PrintHex(RTOS_GetCriticalSectionProfileDropped(), 1);
+
+#if defined(RTOS_SMP)
+	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
+	{
+		if (RTOS_OK == RTOS_GetLockSpinStatistics(i, &spin))
+		{
+			rtos_debug_PrintStrPadded("Lock spin (max count):",RTOS_FIELD_WIDTH);
+			rtos_debug_PrintHex(spin.MaxCycles, 0);
+			rtos_debug_PrintHex(spin.Count, 1);
+		}
+	}
+#endif
+}
+#endif
+
 void rtos_Debug(void)
 {
 	rtos_debug_PrintOS();
@@ -32,6 +32,9 @@ extern void rtos_Debug(void);
 extern void rtos_debug_PrintOS(void);
 extern void rtos_debug_PrintAllTasks(void);
 extern void rtos_debug_PrintTask(const RTOS_Task *task);
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+extern void rtos_debug_PrintCriticalSections(void);
+#endif
 
 #endif
 
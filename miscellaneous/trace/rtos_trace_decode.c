@@ -0,0 +1,428 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Host side decoder for the kernel event trace (see rtos/rtos_trace.h).
+//
+// Build:	gcc -O2 -I../../rtos -o rtos_trace_decode rtos_trace_decode.c rtos_trace_json.c
+// Usage:	rtos_trace_decode [-f counter_frequency_in_Hz] [-n priority=name ...] [-j out.json] dump.bin
+//
+// The input is a raw memory dump of RTOS_TraceBuffers[], e.g. from gdb:
+//	dump binary value trace.bin RTOS_TraceBuffers
+// The buffers of all CPUs are decoded and merged into a single time line.
+// Time stamps are 32 bit cycle counter values, they are extended to 64 bits assuming that
+// consecutive events on the same CPU are less than one wrap around period apart (the timer tick guarantees that).
+// On multi-core targets where each CPU has its own cycle counter (e.g. Cortex-A9) the counters are not synchronized,
+// so the order of events on different CPUs is only approximate.
+// With -j the trace is written as Chrome Trace Event JSON (open it in ui.perfetto.dev) instead of text,
+// task names are not in the dump, they can be given with -n.
+// The counter frequency does not have to be a whole number of MHz, with -f -j the JSON time stamps are converted to
+// nanoseconds here, so consecutive events on the same CPU must then be less than ~4.29 s apart.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtos_trace.h>
+#include "rtos_trace_json.h"
+
+#define MAX_CPUS	64
+#define MAX_TASKS	256
+
+struct Event
+{
+	uint64_t	Time;
+	uint32_t	Info;
+	uint32_t	Data;
+	unsigned	Cpu;
+};
+
+struct Cpu
+{
+	struct Event	*Events;
+	uint32_t	Count;
+	uint64_t	Lost;
+	uint32_t	Next;
+};
+
+static uint32_t Swap32(uint32_t x)
+{
+	return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+static uint32_t ReadWord(const unsigned char *p, int swap)
+{
+	uint32_t x;
+
+	memcpy(&x, p, sizeof(x));
+	return swap ? Swap32(x) : x;
+}
+
+static void FileSink(void *context, const char *text)
+{
+	fputs(text, (FILE *)context);
+}
+
+static void PrintTask(uint32_t task)
+{
+	if (RTOS_TRACE_NO_TASK == task)
+	{
+		printf("  -");
+	}
+	else
+	{
+		printf("%3u", (unsigned)task);
+	}
+}
+
+static void PrintDetails(const struct Event *e)
+{
+	uint32_t type = RTOS_TRACE_INFO_TYPE(e->Info);
+	uint32_t extra = RTOS_TRACE_INFO_EXTRA(e->Info);
+
+	switch (type)
+	{
+	case RTOS_TRACE_EVENT_CONTEXT_SWITCH:
+		printf("from ");
+		PrintTask(extra & 0xFF);
+		printf(" (status 0x%x)", (unsigned)e->Data);
+		break;
+	case RTOS_TRACE_EVENT_ISR_ENTER:
+	case RTOS_TRACE_EVENT_ISR_EXIT:
+		printf("vector 0x%x", (unsigned)extra);
+		break;
+	case RTOS_TRACE_EVENT_SEMAPHORE_POST:
+		printf("sem 0x%08x count %u", (unsigned)e->Data, (unsigned)extra);
+		break;
+	case RTOS_TRACE_EVENT_SEMAPHORE_GET:
+		printf("sem 0x%08x result %d", (unsigned)e->Data, (int)(int16_t)extra);
+		break;
+	case RTOS_TRACE_EVENT_TASK_BLOCK:
+	case RTOS_TRACE_EVENT_TASK_UNBLOCK:
+	case RTOS_TRACE_EVENT_TIMEOUT:
+		printf("task %u event 0x%08x", (unsigned)extra, (unsigned)e->Data);
+		break;
+	case RTOS_TRACE_EVENT_DELAY:
+		printf("until tick %u", (unsigned)e->Data);
+		break;
+	case RTOS_TRACE_EVENT_QUEUE_ENQUEUE:
+	case RTOS_TRACE_EVENT_QUEUE_PREPEND:
+	case RTOS_TRACE_EVENT_QUEUE_DEQUEUE:
+	case RTOS_TRACE_EVENT_QUEUE_PEEK:
+		printf("queue 0x%08x slot %u", (unsigned)e->Data, (unsigned)extra);
+		break;
+	default:
+		printf("type 0x%02x extra 0x%04x data 0x%08x", (unsigned)type, (unsigned)extra, (unsigned)e->Data);
+		break;
+	}
+}
+
+// Decode one CPU's buffer starting at p, returns the number of bytes consumed or 0 if there is no valid buffer.
+static size_t DecodeBuffer(const unsigned char *p, size_t length, unsigned cpu, struct Cpu *out)
+{
+	const size_t headerSize = sizeof(RTOS_TraceHeader);
+	const size_t recordSize = sizeof(RTOS_TraceRecord);
+	uint32_t magic;
+	uint32_t size;
+	uint32_t head;
+	uint32_t wraps;
+	uint32_t first;
+	uint32_t i;
+	uint64_t time = 0;
+	uint32_t previous = 0;
+	int swap;
+
+	if (length < headerSize)
+	{
+		return 0;
+	}
+
+	magic = ReadWord(p, 0);
+
+	if (RTOS_TRACE_MAGIC == magic)
+	{
+		swap = 0;
+	}
+	else if (RTOS_TRACE_MAGIC == Swap32(magic))
+	{
+		swap = 1;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (RTOS_TRACE_FORMAT_VERSION != ReadWord(p + 4, swap))
+	{
+		fprintf(stderr, "CPU %u: unsupported trace format version %u.\n", cpu, (unsigned)ReadWord(p + 4, swap));
+		return 0;
+	}
+
+	size = ReadWord(p + 8, swap);
+	head = ReadWord(p + 12, swap);
+	wraps = ReadWord(p + 16, swap);
+
+	if ((0 == size) || (0 != (size & (size - 1))) || ((length - headerSize) / recordSize < size))
+	{
+		fprintf(stderr, "CPU %u: truncated or corrupt trace buffer.\n", cpu);
+		return 0;
+	}
+
+	// Head wraps around at 2^32, only Wraps tells a full buffer from one that has seen fewer than Size events.
+	out->Count = ((0 == wraps) && (head < size)) ? head : size;
+	out->Lost = (((uint64_t)wraps) << 32) + head - out->Count;
+	out->Next = 0;
+	out->Events = calloc(out->Count ? out->Count : 1, sizeof(struct Event));
+
+	if (0 == out->Events)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	first = head - out->Count;
+
+	for (i = 0; i < out->Count; i++)
+	{
+		const unsigned char *r = p + headerSize + recordSize * ((first + i) & (size - 1));
+		uint32_t stamp = ReadWord(r, swap);
+
+		time += (uint32_t)(stamp - previous);
+		previous = stamp;
+
+		out->Events[i].Time = time;
+		out->Events[i].Info = ReadWord(r + 4, swap);
+		out->Events[i].Data = ReadWord(r + 8, swap);
+		out->Events[i].Cpu = cpu;
+	}
+
+	return headerSize + recordSize * size;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *fileName = 0;
+	double frequency = 0.0;
+	double ticksPerMicrosecond = 0.0;
+	unsigned char *data;
+	size_t length;
+	size_t offset = 0;
+	size_t consumed;
+	struct Cpu cpus[MAX_CPUS];
+	unsigned cpuCount = 0;
+	unsigned i;
+	const char *jsonName = 0;
+	const char *taskNames[MAX_TASKS];
+	char *equals;
+	unsigned long priority;
+	uint32_t j;
+	RTOS_TraceJsonWriter writer;
+	RTOS_TraceRecord record;
+	uint64_t start = UINT64_MAX;
+	FILE *f;
+	long fileSize;
+
+	memset(taskNames, 0, sizeof(taskNames));
+
+	for (i = 1; i < (unsigned)argc; i++)
+	{
+		if ((0 == strcmp(argv[i], "-f")) && (i + 1 < (unsigned)argc))
+		{
+			frequency = atof(argv[++i]);
+
+			if (!(frequency > 0.0))
+			{
+				fprintf(stderr, "Bad counter frequency '%s'.\n", argv[i]);
+				return 2;
+			}
+			ticksPerMicrosecond = frequency / 1.0e6;
+		}
+		else if ((0 == strcmp(argv[i], "-j")) && (i + 1 < (unsigned)argc))
+		{
+			jsonName = argv[++i];
+		}
+		else if ((0 == strcmp(argv[i], "-n")) && (i + 1 < (unsigned)argc))
+		{
+			priority = strtoul(argv[++i], &equals, 0);
+
+			if (('=' != *equals) || (priority >= MAX_TASKS))
+			{
+				fprintf(stderr, "Bad task name '%s', use priority=name.\n", argv[i]);
+				return 2;
+			}
+			taskNames[priority] = equals + 1;
+		}
+		else
+		{
+			fileName = argv[i];
+		}
+	}
+
+	if (0 == fileName)
+	{
+		fprintf(stderr, "Usage: %s [-f counter_frequency_in_Hz] [-n priority=name ...] [-j out.json] dump.bin\n", argv[0]);
+		return 2;
+	}
+
+	f = fopen(fileName, "rb");
+
+	if (0 == f)
+	{
+		perror(fileName);
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	fileSize = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (fileSize <= 0)
+	{
+		fprintf(stderr, "%s: empty file.\n", fileName);
+		fclose(f);
+		return 1;
+	}
+
+	length = (size_t)fileSize;
+	data = malloc(length);
+
+	if ((0 == data) || (length != fread(data, 1, length, f)))
+	{
+		fprintf(stderr, "%s: cannot read file.\n", fileName);
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	while ((cpuCount < sizeof(cpus) / sizeof(cpus[0])) && (0 != (consumed = DecodeBuffer(data + offset, length - offset, cpuCount, &cpus[cpuCount]))))
+	{
+		offset += consumed;
+		cpuCount++;
+	}
+
+	if (0 == cpuCount)
+	{
+		fprintf(stderr, "%s: no trace buffer found.\n", fileName);
+		return 1;
+	}
+
+	if (0 != jsonName)
+	{
+		f = fopen(jsonName, "w");
+
+		if (0 == f)
+		{
+			perror(jsonName);
+			return 1;
+		}
+
+		// The writer only divides by a whole number of cycles per microsecond, hand it nanoseconds instead of cycles.
+		rtos_trace_JsonBegin(&writer, &FileSink, f, (ticksPerMicrosecond > 0.0) ? 1000 : 0);
+
+		for (i = 0; i < cpuCount; i++)
+		{
+			rtos_trace_JsonCpuName(&writer, i);
+
+			for (j = 0; j < MAX_TASKS; j++)
+			{
+				if (0 != taskNames[j])
+				{
+					rtos_trace_JsonTaskName(&writer, i, j, taskNames[j]);
+				}
+			}
+		}
+
+		for (i = 0; i < cpuCount; i++)
+		{
+			rtos_trace_JsonStartCpu(&writer, i);
+
+			for (j = 0; j < cpus[i].Count; j++)
+			{
+				if (ticksPerMicrosecond > 0.0)
+				{
+					record.Timestamp = (uint32_t)(uint64_t)((double)(cpus[i].Events[j].Time) * 1000.0 / ticksPerMicrosecond);
+				}
+				else
+				{
+					record.Timestamp = (uint32_t)(cpus[i].Events[j].Time);
+				}
+				record.Info = cpus[i].Events[j].Info;
+				record.Data = cpus[i].Events[j].Data;
+				rtos_trace_JsonEvent(&writer, &record);
+			}
+		}
+
+		rtos_trace_JsonEnd(&writer);
+		fclose(f);
+		return 0;
+	}
+
+	for (i = 0; i < cpuCount; i++)
+	{
+		printf("# CPU %u: %u events, %llu lost (overwritten).\n", i, (unsigned)cpus[i].Count, (unsigned long long)cpus[i].Lost);
+
+		if ((0 != cpus[i].Count) && (cpus[i].Events[0].Time < start))
+		{
+			start = cpus[i].Events[0].Time;
+		}
+	}
+
+	// Merge the per CPU time lines.
+	for (;;)
+	{
+		struct Event *e = 0;
+		struct Cpu *from = 0;
+
+		for (i = 0; i < cpuCount; i++)
+		{
+			if ((cpus[i].Next < cpus[i].Count) && ((0 == e) || (cpus[i].Events[cpus[i].Next].Time < e->Time)))
+			{
+				from = &cpus[i];
+				e = &(from->Events[from->Next]);
+			}
+		}
+
+		if (0 == e)
+		{
+			break;
+		}
+
+		from->Next++;
+
+		if (ticksPerMicrosecond > 0.0)
+		{
+			printf("%14.3f us", (double)(e->Time - start) / ticksPerMicrosecond);
+		}
+		else
+		{
+			printf("%14llu", (unsigned long long)(e->Time - start));
+		}
+
+		printf("  cpu%-2u task", e->Cpu);
+		PrintTask(RTOS_TRACE_INFO_TASK(e->Info));
+		printf("  %-10s ", rtos_trace_EventName(RTOS_TRACE_INFO_TYPE(e->Info)));
+		PrintDetails(e);
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <rtos.h>
+#include "board.h"
+#include "rtos_trace_json.h"
+#include "rtos_trace_export.h"
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_TRACE)
+// Export the contents of the kernel trace buffers as Chrome Trace Event JSON through a sink.
+// Task names and priorities are taken from the task list at the time of the export.
+// The trace keeps running during the export, records overwritten while being read are dropped.
+
+// A sink sending the text to the board's console (typically a UART).
+void rtos_trace_UartSink(void *context, const char *text)
+{
+	char c;
+
+	while (0 != (c = *text++))
+	{
+		if ('\n' == c)
+		{
+			Board_Putc('\r');
+		}
+		Board_Putc(c);
+	}
+	(void)context;
+}
+
+// Read a record unless it has already been overwritten, returns 0 on success.
+static int rtos_trace_ReadRecord(RTOS_TraceBuffer *buffer, uint32_t index, RTOS_TraceRecord *record)
+{
+	volatile RTOS_TraceRecord *source;
+	uint32_t head;
+	RTOS_SavedCriticalState(saved_state);
+
+	source = &(buffer->Events[index & ((RTOS_TRACE_BUFFER_SIZE) - 1)]);
+
+	RTOS_EnterCriticalSection(saved_state);
+	record->Timestamp = source->Timestamp;
+	record->Info = source->Info;
+	record->Data = source->Data;
+	head = buffer->Header.Head;
+	RTOS_ExitCriticalSection(saved_state);
+
+	// On SMP systems another CPU can write its own buffer at any time, check that the slot was not reused while reading.
+	return ((head - index) < (RTOS_TRACE_BUFFER_SIZE)) ? 0 : -1;
+}
+
+void rtos_trace_ExportJson(RTOS_TraceJsonSink sink, void *context, uint32_t cyclesPerMicrosecond)
+{
+	RTOS_TraceJsonWriter writer;
+	RTOS_TraceRecord record;
+	RTOS_TraceBuffer *buffer;
+	RTOS_Task *task;
+	RTOS_TaskPriority priority;
+	uint32_t cpu;
+	uint32_t head;
+	uint32_t index;
+
+	rtos_trace_JsonBegin(&writer, sink, context, cyclesPerMicrosecond);
+
+	for (cpu = 0; cpu < (RTOS_TRACE_CPUS); cpu++)
+	{
+		rtos_trace_JsonCpuName(&writer, cpu);
+
+		for (priority = 0; priority <= RTOS_Priority_Highest; priority++)
+		{
+			task = RTOS_TaskFromPriority(priority);
+
+			if (0 != task)
+			{
+#if defined(RTOS_TASK_NAME_LENGTH)
+				rtos_trace_JsonTaskName(&writer, cpu, priority, RTOS_GetTaskName(task));
+#else
+				rtos_trace_JsonTaskName(&writer, cpu, priority, (RTOS_Priority_Idle == priority) ? "Idle" : "Task");
+#endif
+			}
+		}
+	}
+
+	for (cpu = 0; cpu < (RTOS_TRACE_CPUS); cpu++)
+	{
+		buffer = &(RTOS_TraceBuffers[cpu]);
+		head = buffer->Header.Head;
+		index = head - (RTOS_TRACE_BUFFER_SIZE);		// Unsigned arithmetic, Head may have wrapped around.
+
+		if ((0 == buffer->Header.Wraps) && (head < (RTOS_TRACE_BUFFER_SIZE)))
+		{
+			index = 0;					// The buffer has never been filled.
+		}
+
+		rtos_trace_JsonStartCpu(&writer, cpu);
+
+		for (; index != head; index++)
+		{
+			if (0 == rtos_trace_ReadRecord(buffer, index, &record))
+			{
+				rtos_trace_JsonEvent(&writer, &record);
+			}
+		}
+	}
+
+	rtos_trace_JsonEnd(&writer);
+}
+#endif
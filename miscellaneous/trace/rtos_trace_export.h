@@ -0,0 +1,47 @@
+#ifndef RTOS_TRACE_EXPORT_H
+#define RTOS_TRACE_EXPORT_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Target side export of the kernel trace, see rtos_trace_json.h for the format and the memory sink.
+// Usage (e.g. from a low priority task, after something interesting has happened):
+//	rtos_trace_ExportJson(&rtos_trace_UartSink, 0, CPU_CLOCK_MHZ);
+// or into memory for a later dump with a debugger:
+//	RTOS_TraceMemorySink mem = { buffer, sizeof(buffer), 0 };
+//	rtos_trace_ExportJson(&rtos_trace_MemorySink, &mem, CPU_CLOCK_MHZ);
+
+#include <stdint.h>
+#include "rtos_trace_json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void rtos_trace_UartSink(void *context, const char *text);
+extern void rtos_trace_ExportJson(RTOS_TraceJsonSink sink, void *context, uint32_t cyclesPerMicrosecond);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
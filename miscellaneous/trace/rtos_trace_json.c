@@ -0,0 +1,345 @@
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#include <stdint.h>
+#include <rtos_trace.h>
+#include "rtos_trace_json.h"
+
+#define LINE_LENGTH	256
+#define NAME_LENGTH	64	/* Task names are cut at this length. */
+
+static char *rtos_trace_PutStr(char *p, const char *s)
+{
+	while (0 != *s)
+	{
+		*p++ = *s++;
+	}
+	return p;
+}
+
+// Put a string as the contents of a JSON string literal.
+static char *rtos_trace_PutEscaped(char *p, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+	int i;
+
+	for (i = 0; (i < (NAME_LENGTH)) && (0 != (c = (unsigned char)s[i])); i++)
+	{
+		if (('"' == c) || ('\\' == c))
+		{
+			*p++ = '\\';
+			*p++ = (char)c;
+		}
+		else if (c < 0x20)
+		{
+			p = rtos_trace_PutStr(p, "\\u00");
+			*p++ = hex[c >> 4];
+			*p++ = hex[c & 0x0F];
+		}
+		else
+		{
+			*p++ = (char)c;
+		}
+	}
+	return p;
+}
+
+static char *rtos_trace_PutDec(char *p, uint32_t x)
+{
+	char digits[10];
+	int n = 0;
+
+	do
+	{
+		digits[n++] = (char)('0' + (x % 10));
+		x /= 10;
+	} while (0 != x);
+
+	while (n > 0)
+	{
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+static char *rtos_trace_PutHex(char *p, uint32_t x)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
+
+	*p++ = '0';
+	*p++ = 'x';
+	for (i = 28; i >= 0; i -= 4)
+	{
+		*p++ = hex[(x >> i) & 0x0F];
+	}
+	return p;
+}
+
+// Emit one item of the traceEvents array.
+static void rtos_trace_JsonItem(RTOS_TraceJsonWriter *writer, char *line, char *end)
+{
+	*end = '\0';
+
+	if (0 != writer->Items)
+	{
+		writer->Sink(writer->Context, ",\n");
+	}
+	writer->Sink(writer->Context, line);
+	writer->Items++;
+}
+
+// Start an item: {"ph":"PH","pid":CPU,"tid":TID
+static char *rtos_trace_JsonStartItem(RTOS_TraceJsonWriter *writer, char *p, const char *ph, uint32_t tid)
+{
+	p = rtos_trace_PutStr(p, "{\"ph\":\"");
+	p = rtos_trace_PutStr(p, ph);
+	p = rtos_trace_PutStr(p, "\",\"pid\":");
+	p = rtos_trace_PutDec(p, writer->Cpu);
+	p = rtos_trace_PutStr(p, ",\"tid\":");
+	return rtos_trace_PutDec(p, tid);
+}
+
+static char *rtos_trace_JsonTime(RTOS_TraceJsonWriter *writer, char *p)
+{
+	uint32_t fraction;
+
+	p = rtos_trace_PutStr(p, ",\"ts\":");
+	p = rtos_trace_PutDec(p, writer->Microseconds);
+
+	if (writer->CyclesPerMicrosecond > 1)
+	{
+		// Remainder < CyclesPerMicrosecond, so this cannot overflow for any realistic clock frequency.
+		fraction = (writer->Remainder * 1000) / writer->CyclesPerMicrosecond;
+		*p++ = '.';
+		*p++ = (char)('0' + fraction / 100);
+		*p++ = (char)('0' + (fraction / 10) % 10);
+		*p++ = (char)('0' + fraction % 10);
+	}
+	return p;
+}
+
+static void rtos_trace_JsonAdvanceTime(RTOS_TraceJsonWriter *writer, uint32_t stamp)
+{
+	uint32_t delta;
+	uint32_t cyclesPerUs = writer->CyclesPerMicrosecond;
+
+	if (!writer->Started)
+	{
+		writer->Started = 1;
+		writer->Previous = stamp;
+		writer->Microseconds = (0 == cyclesPerUs) ? stamp : (stamp / cyclesPerUs);
+		writer->Remainder = (0 == cyclesPerUs) ? 0 : (stamp % cyclesPerUs);
+		return;
+	}
+
+	// Wrap around safe, as long as consecutive events are less than 2^32 cycles apart.
+	delta = stamp - writer->Previous;
+	writer->Previous = stamp;
+
+	if (0 == cyclesPerUs)
+	{
+		writer->Microseconds += delta;
+		return;
+	}
+
+	writer->Microseconds += delta / cyclesPerUs;
+	writer->Remainder += delta % cyclesPerUs;
+
+	if (writer->Remainder >= cyclesPerUs)
+	{
+		writer->Remainder -= cyclesPerUs;
+		writer->Microseconds++;
+	}
+}
+
+const char *rtos_trace_EventName(uint32_t type)
+{
+	switch (type)
+	{
+	case RTOS_TRACE_EVENT_CONTEXT_SWITCH:	return "SWITCH";
+	case RTOS_TRACE_EVENT_ISR_ENTER:	return "ISR_ENTER";
+	case RTOS_TRACE_EVENT_ISR_EXIT:		return "ISR_EXIT";
+	case RTOS_TRACE_EVENT_SEMAPHORE_POST:	return "SEM_POST";
+	case RTOS_TRACE_EVENT_SEMAPHORE_GET:	return "SEM_GET";
+	case RTOS_TRACE_EVENT_TASK_BLOCK:	return "BLOCK";
+	case RTOS_TRACE_EVENT_TASK_UNBLOCK:	return "UNBLOCK";
+	case RTOS_TRACE_EVENT_DELAY:		return "DELAY";
+	case RTOS_TRACE_EVENT_TIMEOUT:		return "TIMEOUT";
+	case RTOS_TRACE_EVENT_QUEUE_ENQUEUE:	return "Q_ENQUEUE";
+	case RTOS_TRACE_EVENT_QUEUE_PREPEND:	return "Q_PREPEND";
+	case RTOS_TRACE_EVENT_QUEUE_DEQUEUE:	return "Q_DEQUEUE";
+	case RTOS_TRACE_EVENT_QUEUE_PEEK:	return "Q_PEEK";
+	default:				return (type >= RTOS_TRACE_EVENT_USER) ? "USER" : "UNKNOWN";
+	}
+}
+
+void rtos_trace_JsonBegin(RTOS_TraceJsonWriter *writer, RTOS_TraceJsonSink sink, void *context, uint32_t cyclesPerMicrosecond)
+{
+	writer->Sink = sink;
+	writer->Context = context;
+	writer->CyclesPerMicrosecond = cyclesPerMicrosecond;
+	writer->Items = 0;
+	writer->Cpu = 0;
+	writer->Started = 0;
+
+	sink(context, "{\"displayTimeUnit\":\"ns\",");
+	sink(context, (0 == cyclesPerMicrosecond) ? "\"otherData\":{\"ts\":\"cycles\"},\n" : "\"otherData\":{\"ts\":\"us\"},\n");
+	sink(context, "\"traceEvents\":[\n");
+}
+
+void rtos_trace_JsonCpuName(RTOS_TraceJsonWriter *writer, uint32_t cpu)
+{
+	char line[LINE_LENGTH];
+	char *p;
+
+	writer->Cpu = cpu;
+
+	p = rtos_trace_JsonStartItem(writer, line, "M", 0);
+	p = rtos_trace_PutStr(p, ",\"name\":\"process_name\",\"args\":{\"name\":\"CPU ");
+	p = rtos_trace_PutDec(p, cpu);
+	p = rtos_trace_PutStr(p, "\"}}");
+	rtos_trace_JsonItem(writer, line, p);
+
+	p = rtos_trace_JsonStartItem(writer, line, "M", RTOS_TRACE_JSON_ISR_TID);
+	p = rtos_trace_PutStr(p, ",\"name\":\"thread_name\",\"args\":{\"name\":\"Interrupts\"}}");
+	rtos_trace_JsonItem(writer, line, p);
+}
+
+// Task names and priorities are metadata of the task's thread, higher priority tasks are sorted to the top.
+void rtos_trace_JsonTaskName(RTOS_TraceJsonWriter *writer, uint32_t cpu, uint32_t priority, const char *name)
+{
+	char line[LINE_LENGTH];
+	char *p;
+
+	writer->Cpu = cpu;
+
+	p = rtos_trace_JsonStartItem(writer, line, "M", priority);
+	p = rtos_trace_PutStr(p, ",\"name\":\"thread_name\",\"args\":{\"name\":\"");
+	p = rtos_trace_PutEscaped(p, (0 != name) ? name : "");
+	p = rtos_trace_PutStr(p, " [");
+	p = rtos_trace_PutDec(p, priority);
+	p = rtos_trace_PutStr(p, "]\",\"priority\":");
+	p = rtos_trace_PutDec(p, priority);
+	p = rtos_trace_PutStr(p, "}}");
+	rtos_trace_JsonItem(writer, line, p);
+
+	p = rtos_trace_JsonStartItem(writer, line, "M", priority);
+	p = rtos_trace_PutStr(p, ",\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":");
+	p = rtos_trace_PutDec(p, RTOS_TRACE_NO_TASK - priority);
+	p = rtos_trace_PutStr(p, "}}");
+	rtos_trace_JsonItem(writer, line, p);
+}
+
+void rtos_trace_JsonStartCpu(RTOS_TraceJsonWriter *writer, uint32_t cpu)
+{
+	writer->Cpu = cpu;
+	writer->Started = 0;
+}
+
+void rtos_trace_JsonEvent(RTOS_TraceJsonWriter *writer, const RTOS_TraceRecord *record)
+{
+	char line[LINE_LENGTH];
+	char *p;
+	uint32_t type = RTOS_TRACE_INFO_TYPE(record->Info);
+	uint32_t task = RTOS_TRACE_INFO_TASK(record->Info);
+	uint32_t extra = RTOS_TRACE_INFO_EXTRA(record->Info);
+
+	rtos_trace_JsonAdvanceTime(writer, record->Timestamp);
+
+	switch (type)
+	{
+	case RTOS_TRACE_EVENT_CONTEXT_SWITCH:
+		// End the slice of the previous task, begin one for the next task.
+		if (RTOS_TRACE_NO_TASK != (extra & 0xFF))
+		{
+			p = rtos_trace_JsonStartItem(writer, line, "E", extra & 0xFF);
+			p = rtos_trace_JsonTime(writer, p);
+			p = rtos_trace_PutStr(p, ",\"args\":{\"status\":");
+			p = rtos_trace_PutDec(p, record->Data);
+			p = rtos_trace_PutStr(p, "}}");
+			rtos_trace_JsonItem(writer, line, p);
+		}
+
+		if (RTOS_TRACE_NO_TASK != task)
+		{
+			p = rtos_trace_JsonStartItem(writer, line, "B", task);
+			p = rtos_trace_JsonTime(writer, p);
+			p = rtos_trace_PutStr(p, ",\"name\":\"Running\"}");
+			rtos_trace_JsonItem(writer, line, p);
+		}
+		break;
+
+	case RTOS_TRACE_EVENT_ISR_ENTER:
+		p = rtos_trace_JsonStartItem(writer, line, "B", RTOS_TRACE_JSON_ISR_TID);
+		p = rtos_trace_JsonTime(writer, p);
+		p = rtos_trace_PutStr(p, ",\"name\":\"ISR ");
+		p = rtos_trace_PutDec(p, extra);
+		p = rtos_trace_PutStr(p, "\"}");
+		rtos_trace_JsonItem(writer, line, p);
+		break;
+
+	case RTOS_TRACE_EVENT_ISR_EXIT:
+		p = rtos_trace_JsonStartItem(writer, line, "E", RTOS_TRACE_JSON_ISR_TID);
+		p = rtos_trace_JsonTime(writer, p);
+		p = rtos_trace_PutStr(p, "}");
+		rtos_trace_JsonItem(writer, line, p);
+		break;
+
+	default:
+		// Everything else is an instant event on the thread of the task that caused it.
+		p = rtos_trace_JsonStartItem(writer, line, "i", (RTOS_TRACE_NO_TASK == task) ? RTOS_TRACE_JSON_ISR_TID : task);
+		p = rtos_trace_JsonTime(writer, p);
+		p = rtos_trace_PutStr(p, ",\"s\":\"t\",\"name\":\"");
+		p = rtos_trace_PutStr(p, rtos_trace_EventName(type));
+		p = rtos_trace_PutStr(p, "\",\"args\":{\"extra\":");
+		p = rtos_trace_PutDec(p, extra);
+		p = rtos_trace_PutStr(p, ",\"data\":\"");
+		p = rtos_trace_PutHex(p, record->Data);
+		p = rtos_trace_PutStr(p, "\"}}");
+		rtos_trace_JsonItem(writer, line, p);
+		break;
+	}
+}
+
+void rtos_trace_JsonEnd(RTOS_TraceJsonWriter *writer)
+{
+	writer->Sink(writer->Context, "\n]}\n");
+}
+
+void rtos_trace_MemorySink(void *context, const char *text)
+{
+	RTOS_TraceMemorySink *sink = (RTOS_TraceMemorySink *)context;
+
+	if (0 == sink->Size)
+	{
+		return;
+	}
+
+	while ((0 != *text) && (sink->Length < sink->Size - 1))
+	{
+		sink->Buffer[sink->Length++] = *text++;
+	}
+	sink->Buffer[sink->Length] = '\0';
+}
@@ -0,0 +1,87 @@
+#ifndef RTOS_TRACE_JSON_H
+#define RTOS_TRACE_JSON_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Conversion of kernel trace records (see rtos/rtos_trace.h) to the Chrome Trace Event JSON format,
+// which can be opened by Perfetto (ui.perfetto.dev) and chrome://tracing.
+// The writer does not depend on the OS, it is used on the target (rtos_trace_export.c) and by the host decoder.
+//
+// Each CPU is shown as a process (pid = CPU number), each task as a thread of that process (tid = task priority),
+// interrupts are shown on a separate thread (tid = RTOS_TRACE_JSON_ISR_TID).
+// No floating point and no 64 bit division is used, so it can run on small targets without libgcc.
+// Time stamps are in microseconds if the cycle counter frequency is known, they wrap around after 2^32 us (~71 minutes).
+
+#include <stdint.h>
+#include <rtos_trace.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTOS_TRACE_JSON_ISR_TID	256
+
+// A sink receives the JSON text in pieces.
+typedef void (*RTOS_TraceJsonSink)(void *context, const char *text);
+
+struct rtos_TraceJsonWriter
+{
+	RTOS_TraceJsonSink	Sink;
+	void			*Context;
+	uint32_t		CyclesPerMicrosecond;	// 0 means that time stamps are emitted in raw cycles.
+	uint32_t		Items;			// Number of JSON items written so far.
+	// State of the time line of the current CPU.
+	uint32_t		Cpu;
+	uint32_t		Started;
+	uint32_t		Previous;		// Previous raw time stamp.
+	uint32_t		Microseconds;
+	uint32_t		Remainder;		// Cycles not yet accounted for in Microseconds.
+};
+typedef struct rtos_TraceJsonWriter RTOS_TraceJsonWriter;
+
+extern const char *rtos_trace_EventName(uint32_t type);
+
+extern void rtos_trace_JsonBegin(RTOS_TraceJsonWriter *writer, RTOS_TraceJsonSink sink, void *context, uint32_t cyclesPerMicrosecond);
+extern void rtos_trace_JsonCpuName(RTOS_TraceJsonWriter *writer, uint32_t cpu);
+extern void rtos_trace_JsonTaskName(RTOS_TraceJsonWriter *writer, uint32_t cpu, uint32_t priority, const char *name);
+// Events must be passed in the order they were recorded, one CPU at a time.
+extern void rtos_trace_JsonStartCpu(RTOS_TraceJsonWriter *writer, uint32_t cpu);
+extern void rtos_trace_JsonEvent(RTOS_TraceJsonWriter *writer, const RTOS_TraceRecord *record);
+extern void rtos_trace_JsonEnd(RTOS_TraceJsonWriter *writer);
+
+// A sink collecting the output in memory, the text is truncated (but always terminated) if the buffer is too small.
+struct rtos_TraceMemorySink
+{
+	char		*Buffer;
+	uint32_t	Size;
+	uint32_t	Length;
+};
+typedef struct rtos_TraceMemorySink RTOS_TraceMemorySink;
+
+extern void rtos_trace_MemorySink(void *context, const char *text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -50,6 +50,20 @@ RTOS_RegInt rtos_CreateTask(RTOS_Task *task, void *sp0, unsigned long stackCapac
 	task->Action = f;
 	task->Parameter = param;
 	task->SP0 = sp0;
+	task->Status = RTOS_TASK_STATUS_ACTIVE;	// The structure may be reused after the task was killed.
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	task->RunTime = 0;			// Nor does it inherit the run time of the previous task.
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	task->WakeupPending = 0;		// Or its wake-up latencies.
+	for (i = 0; i < (RTOS_LATENCY_BUCKETS); i++)
+	{
+		task->WakeupLatency.Buckets[i] = 0;
+	}
+	task->WakeupLatency.Count = 0;
+	task->WakeupLatency.Min = 0;
+	task->WakeupLatency.Max = 0;
+#endif
 
 	rtos_TargetInitializeTask(task, stackCapacity);
 
@@ -89,6 +103,8 @@ RTOS_RegInt rtos_RegisterTask(RTOS_Task *task, RTOS_TaskPriority priority)
 
 #if defined(RTOS_SMP)
 	rtos_RestrictPriorityToCpus(priority, ~(RTOS_CpuMask)0);
+	task->PreferredCpu = RTOS_CPUID_NO_CPU;
+	rtos_RemoveFromRunQueues(task);
 #endif
 
 #if defined(RTOS_SUPPORT_TIMESHARE)
@@ -223,6 +239,9 @@ RTOS_RegInt RTOS_KillSelf(void)
 	// Remove task from the list of valid tasks and mark it as killed.
 	RTOS.TaskList[priority] = 0;
 	task->Status = RTOS_TASK_STATUS_KILLED;
+#if defined(rtos_TargetTaskKilled)
+	rtos_TargetTaskKilled(task);
+#endif
 
 	RTOS_INVOKE_SCHEDULER();
 
@@ -287,6 +306,12 @@ void rtos_Scheduler(void)
 	RTOS_TaskPriority priority;
 	RTOS_Task *task;
 
+	RTOS.RescheduleNeeded = 0;
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(RTOS.CurrentTask);
+#endif
+
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	rtos_ManageTimeshared(RTOS.CurrentTask);
 #endif
@@ -302,9 +327,22 @@ void rtos_Scheduler(void)
 
 	if (0 != task)
 	{
+#if defined(RTOS_INCLUDE_TRACE)
+		if (task != RTOS.CurrentTask)
+		{
+			rtos_TraceContextSwitch(RTOS.CurrentTask, task);
+		}
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+		if (task->WakeupPending)
+		{
+			rtos_RecordWakeupLatency(task);
+		}
+#endif
 		RTOS.CurrentTask = task;
 	}
 }
+
 #endif
 
 #if defined(RTOS_INVOKE_YIELD)
@@ -318,6 +356,11 @@ void rtos_SchedulerForYield(void)
 	RTOS_TaskSet t;
 	RTOS_Task *currentTask;
 	currentTask = RTOS.CurrentTask;
+	RTOS.RescheduleNeeded = 0;
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(currentTask);
+#endif
 
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	rtos_ManageTimeshared(currentTask);
@@ -349,6 +392,18 @@ void rtos_SchedulerForYield(void)
 
 	if (0 != task)
 	{
+#if defined(RTOS_INCLUDE_TRACE)
+		if (task != currentTask)
+		{
+			rtos_TraceContextSwitch(currentTask, task);
+		}
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+		if (task->WakeupPending)
+		{
+			rtos_RecordWakeupLatency(task);
+		}
+#endif
 		RTOS.CurrentTask = task;
 	}
 }
@@ -488,6 +543,7 @@ RTOS_RegInt rtos_Delay(RTOS_Time time, RTOS_RegInt absolute)
 	}
 #endif
     	thisTask->WakeUpTime = absolute ? time : (RTOS.Time + time);
+	RTOS_TRACE(RTOS_TRACE_EVENT_DELAY, 0, thisTask->WakeUpTime);
     	RTOS_TaskSet_RemoveMember(RTOS.ReadyToRunTasks, thisTask->Priority);
     	thisTask->Status = RTOS_TASK_STATUS_SLEEPING;
 #if defined(RTOS_SUPPORT_TIMESHARE)
@@ -530,6 +586,8 @@ RTOS_RegInt RTOS_Delay(RTOS_Time ticksToSleep)
 #if defined(RTOS_SUPPORT_EVENTS)
 void rtos_WaitForEvent(RTOS_EventHandle *event, RTOS_Task *task, RTOS_Time timeout)
 {
+	RTOS_TRACE(RTOS_TRACE_EVENT_TASK_BLOCK, task->Priority, event);
+
         task->WaitFor = event;
         RTOS_TaskSet_AddMember(event->TasksWaiting, task->Priority);
 #if defined(RTOS_SUPPORT_TIMESHARE)
@@ -599,10 +657,14 @@ RTOS_RegInt rtos_SignalEvent(RTOS_EventHandle *event)
 #endif
 		if (0 != task)
 		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_TASK_UNBLOCK, task->Priority, event);
 			RTOS_TaskSet_RemoveMember(event->TasksWaiting, task->Priority); 
 			task->WaitFor = 0;
 			rtos_RemoveFromSleepers(task);
 			RTOS_TaskSet_AddMember(RTOS.ReadyToRunTasks, task->Priority);
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+			rtos_MarkWakeup(task);
+#endif
 			task->Status = RTOS_TASK_STATUS_ACTIVE;
 			return RTOS_OK;
 		}
@@ -642,6 +704,9 @@ RTOS_RegInt RTOS_CreateEventHandle(RTOS_EventHandle *event)
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	event->WaitList.Head = 0;
 	event->WaitList.Tail = 0;
+#endif
+#if defined(RTOS_SMP)
+	event->Lock = 0;
 #endif
 	return RTOS_OK;
 }
@@ -661,6 +726,8 @@ RTOS_RegInt rtos_WakeupTask(RTOS_Task *task)
         	return RTOS_ERROR_OPERATION_NOT_PERMITTED;
 	}
 
+	RTOS_TRACE(RTOS_TRACE_EVENT_TASK_UNBLOCK, task->Priority, task->WaitFor);
+
 	if (0 != task->WaitFor)
 	{
 		rtos_RemoveTaskWaiting(task->WaitFor, task);
@@ -668,6 +735,9 @@ RTOS_RegInt rtos_WakeupTask(RTOS_Task *task)
 
 	rtos_RemoveFromSleepers(task);
 	RTOS_TaskSet_AddMember(RTOS.ReadyToRunTasks, task->Priority);
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_MarkWakeup(task);
+#endif
 
 	task->Status = RTOS_TASK_STATUS_AWAKENED;
 
@@ -739,8 +809,12 @@ RTOS_RegInt RTOS_ResumeTask(RTOS_Task *task)
 	}
 	else
 	{
+		RTOS_TRACE(RTOS_TRACE_EVENT_TASK_UNBLOCK, task->Priority, 0);
 		RTOS_TaskSet_RemoveMember(RTOS.SuspendedTasks, task->Priority);
 		RTOS_TaskSet_AddMember(RTOS.ReadyToRunTasks, task->Priority);
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+		rtos_MarkWakeup(task);
+#endif
 		task->Status &= ~(RTOS_TASK_STATUS_SUSPENDED_FLAG);
 		result = RTOS_OK;
 	}
@@ -753,6 +827,19 @@ RTOS_RegInt RTOS_ResumeTask(RTOS_Task *task)
 }
 #endif
 
+#if !defined(RTOS_SMP)
+// Time slices are charged by the scheduler (see rtos_ManageTimeshared()), so it must run on every tick while time sharing is going on.
+static void rtos_ChargeTimeSlice(void)
+{
+#if defined(RTOS_SUPPORT_TIMESHARE)
+	if (((0 != RTOS.CurrentTask) && (RTOS.CurrentTask->IsTimeshared)) || (0 != RTOS.PreemptedList.Head))
+	{
+		RTOS.RescheduleNeeded = 1;
+	}
+#endif
+}
+#endif
+
 static void rtos_TimerTickFunction(void)
 {
 	RTOS_TaskPriority i;
@@ -779,13 +866,19 @@ static void rtos_TimerTickFunction(void)
 		{
 			if (task->WakeUpTime == RTOS.Time)
 			{
+				RTOS_TRACE(RTOS_TRACE_EVENT_TIMEOUT, i, task->WaitFor);
 				rtos_RemoveFromSleepers(task);
+#if defined(RTOS_SUPPORT_EVENTS)
 				if (0 != task->WaitFor)
                			{
 					rtos_RemoveTaskWaiting(task->WaitFor, task);
 				}
+#endif
 
 				RTOS_TaskSet_AddMember(RTOS.ReadyToRunTasks, i);
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+				rtos_MarkWakeup(task);
+#endif
 				task->Status = RTOS_TASK_STATUS_TIMED_OUT;
 			}
        		}
@@ -820,6 +913,12 @@ void rtos_TimerTick(void)
 	{
 		RTOS_ResumeTask(task);
 	}
+#if !defined(RTOS_SMP)
+	rtos_ChargeTimeSlice();
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(RTOS.CurrentTask);	// The scheduler does not run on every tick, keep the cycle counter from wrapping unnoticed.
+#endif
+#endif
 
 	// Perhaps we need some action for SMP here too.
 	// Check this when SMP features become more mature.
@@ -829,16 +928,60 @@ void rtos_TimerTick(void)
 void rtos_TimerTick(void)
 {
 	rtos_TimerTickFunction();
+#if !defined(RTOS_SMP)
+	rtos_RequestReschedulingFromIsr();
+	rtos_ChargeTimeSlice();
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(RTOS.CurrentTask);	// The scheduler does not run on every tick, keep the cycle counter from wrapping unnoticed.
+#endif
+#endif
 
 #if defined(RTOS_TIMER_EXTRA_ACTION)
 		RTOS_TIMER_EXTRA_ACTION();
 #endif
-#if defined(RTOS_SMP)
-	rtos_SignalCpus(RTOS_CpuMask_RemoveCpu(RTOS.TimeShareCpus, RTOS_CurrentCpu()));
+#if defined(RTOS_SMP) && defined(RTOS_SUPPORT_TIMESHARE)
+	// Tasks woken up by the tick are taken care of by the port when the interrupt returns (see rtos_CpusToReschedule()).
+	rtos_SignalCpus(rtos_ExpiredTimeshareCpus(RTOS_CurrentCpu()));
 #endif
 }
 #endif
 
+#if defined(RTOS_SIMULATION) && defined(RTOS_SUPPORT_SLEEP)
+// In a simulation build time does not have to pass while only the idle task can run.
+// Returns how many ticks can be added to RTOS.Time so that the next call to rtos_TimerTick() wakes up the first sleeper,
+// or RTOS_TIMEOUT_FOREVER if no task is sleeping.
+RTOS_Time rtos_IdleTicksBeforeWakeUp(void)
+{
+	RTOS_TaskPriority i;
+	RTOS_Task *task;
+	RTOS_Time ticks = RTOS_TIMEOUT_FOREVER;
+	RTOS_Time skip;
+
+	for (i = 1; i <= RTOS_Priority_Highest; i++)
+	{
+		task = RTOS.Sleepers[i];
+
+		if (0 != task)
+		{
+			// A wake-up time equal to the current time is a full wrap around away, it takes one extra round to get there.
+			skip = (RTOS_Time)(task->WakeUpTime - RTOS.Time - 1);
+
+			if ((RTOS_TIMEOUT_FOREVER) == skip)
+			{
+				skip--;
+			}
+
+			if (skip < ticks)
+			{
+				ticks = skip;
+			}
+		}
+	}
+
+	return ticks;
+}
+#endif
+
 void rtos_PrepareToStart(void)
 {
 #if defined(RTOS_SMP) && defined(RTOS_SUPPORT_TIMESHARE)
@@ -40,6 +40,10 @@ extern "C" {
 #error RTOS_Priority_Highest must be >= 0.
 #endif
 
+#if defined(RTOS_SIMULATION) && defined(RTOS_SMP)
+#error RTOS_SIMULATION (discrete-event simulation with virtual time) is not supported in SMP mode.
+#endif
+
 #if defined(RTOS_SMP)
 #	warning You have enabled SMP -- SMP is still an experimental feature.
 
@@ -74,6 +78,20 @@ extern "C" {
 
 #include <rtos_types.h>
 
+// Targets with a data cache define RTOS_CACHE_LINE_SIZE in rtos_types.h.
+#if defined(RTOS_CACHE_LINE_SIZE)
+#define RTOS_CACHE_ALIGNED __attribute__((aligned(RTOS_CACHE_LINE_SIZE)))
+#else
+#define RTOS_CACHE_ALIGNED
+#endif
+
+// Alignment only worth the space when more than one CPU shares the data.
+#if defined(RTOS_SMP)
+#define RTOS_SMP_CACHE_ALIGNED RTOS_CACHE_ALIGNED
+#else
+#define RTOS_SMP_CACHE_ALIGNED
+#endif
+
 // Status Codes:
 #define RTOS_ABORTED       			 2	
 #define RTOS_TIMED_OUT                         	 1
@@ -104,6 +122,41 @@ typedef RTOS_TIME_TYPE RTOS_Time;
 typedef uint32_t RTOS_Time;
 #endif
 
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING) || defined(RTOS_INCLUDE_TRACE) || defined(RTOS_INCLUDE_WAKEUP_LATENCY) || defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+#define RTOS_USE_CYCLE_COUNTER
+#endif
+
+#if defined(RTOS_USE_CYCLE_COUNTER)
+// Run time and trace time stamps are measured in units of the target's cycle counter (see RTOS_READ_CYCLE_COUNTER()).
+#if defined(RTOS_CYCLE_COUNTER_TYPE)
+typedef RTOS_CYCLE_COUNTER_TYPE RTOS_CycleCount;
+#else
+typedef uint32_t RTOS_CycleCount;
+#endif
+#endif
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+typedef uint64_t RTOS_RunTime;
+#endif
+
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+#if !defined(RTOS_LATENCY_BUCKETS)
+#define RTOS_LATENCY_BUCKETS 32
+#endif
+
+// Log2 scale histogram of latencies in cycle counter units.
+// Buckets[0] counts latencies of 0 and 1 cycles, Buckets[i] counts latencies in [2^i, 2^(i+1)),
+// the last bucket also counts everything above its range.
+struct rtos_LatencyHistogram
+{
+	uint32_t		Buckets[RTOS_LATENCY_BUCKETS];
+	uint32_t		Count;
+	uint32_t		Min;
+	uint32_t		Max;
+};
+typedef struct rtos_LatencyHistogram RTOS_LatencyHistogram;
+#endif
+
 #if defined(RTOS_REG_INT_TYPE)
 typedef signed   RTOS_REG_INT_TYPE RTOS_RegInt;
 typedef unsigned RTOS_REG_INT_TYPE RTOS_RegUInt;
@@ -145,31 +198,59 @@ struct rtos_Task_DLLink
 };
 typedef struct rtos_Task_DLLink RTOS_Task_DLLink;
 
+#if defined(RTOS_SMP)
+// Per CPU data, the state each CPU updates on its own behalf on every interrupt and context switch.
+// Each block is in cache lines of its own, so CPUs do not keep taking the same line away from each other.
+// CurrentTask must be the first field, the context switch code of the ports relies on it.
+struct rtos_PerCpu
+{
+	RTOS_Task     		*CurrentTask;				// The currently running task on this CPU.
+#if !defined(RTOS_INTERRUPT_CONTEXT_TRACKED_BY_HARDWARE_ONLY)
+	RTOS_RegUInt   		InterruptNesting;			// Level of interrupts nested.
+#endif
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	RTOS_CycleCount		RunTimeStamp;				// Cycle counter value at the last run time update.
+	RTOS_RunTime		CpuIdleTime;				// Time spent idle (idle task or no task at all).
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	uint32_t		IsrEntryStamp;				// Cycle counter value at the entry of the last interrupt.
+#endif
+} RTOS_CACHE_ALIGNED;
+typedef volatile struct rtos_PerCpu RTOS_PerCpu;
+#endif
+
 // The main RTOS structure representing the internal state of the operating system.
+// The fields are grouped by how they are used, so that a pass of the scheduler touches as few cache lines as possible:
+// first the current task(s), then the state changed by every scheduling decision, tick and wake-up,
+// then what is mostly just read, and last the arrays only used when tasks go to sleep or wake up.
+// With SMP each group starts a new cache line and the OS lock has a line of its own, CPUs spinning on the lock
+// should not be disturbed by every write to the state it protects (and vice versa).
 struct rtos_OS
 {
 #if defined(RTOS_SMP)
-	RTOS_Task     		*CurrentTasks[RTOS_SMP_CPU_CORES];	// The currently running task on each CPU.
-#if !defined(RTOS_INTERRUPT_CONTEXT_TRACKED_BY_HARDWARE_ONLY)
-	RTOS_RegUInt   		InterruptNesting[RTOS_SMP_CPU_CORES];	// Level of interrupts nested.
-#endif
-	RTOS_TaskSet		TasksAllowed[RTOS_SMP_CPU_CORES]; 	// Tasks allowed to run on this particular core.
-	RTOS_CpuMutex		OSLock;					// Global lock to prevent access of OS structures from other CPUs.
-	RTOS_TaskSet    	RunningTasks;				// Tasks that are currently running on any CPU.
-	RTOS_CpuMask		Cpus;					// A bitmap of all CPUs.
-	RTOS_CpuMask		CpuHoldingPen;				// CPUs in a 'holding pen' (CPU's not running any task).
+	struct rtos_PerCpu	PerCpu[RTOS_SMP_CPU_CORES];		// Per CPU data, the current task of each CPU etc.
 #else
 	RTOS_Task     		*CurrentTask;				// The currently running task.
 #if !defined(RTOS_INTERRUPT_CONTEXT_TRACKED_BY_HARDWARE_ONLY)
 	RTOS_RegUInt   		InterruptNesting;			// Level of interrupts nested.
 #endif
 #endif
+	// Hot, changed by every scheduling decision, tick or wake-up.
+	RTOS_TaskSet    	ReadyToRunTasks RTOS_SMP_CACHE_ALIGNED;	// Tasks that are ready to run.
+	RTOS_Time		Time;					// System time in ticks.
+	RTOS_RegInt		IsRunning;				// Is the OS running?
 #if defined(RTOS_INCLUDE_SCHEDULER_LOCK)
 	RTOS_RegUInt		SchedulerLocked;			// Is the scheduler locked.
 #endif
-	RTOS_RegInt		IsRunning;				// Is the OS running?
-	RTOS_Time		Time;					// System time in ticks.
-	RTOS_TaskSet    	ReadyToRunTasks;			// Tasks that are ready to run.
+#if !defined(RTOS_SMP)
+	RTOS_RegUInt		RescheduleNeeded;			// Set inside ISRs when the scheduler has to run before the interrupt returns.
+#endif
+#if defined(RTOS_SMP)
+	RTOS_TaskSet    	RunningTasks;				// Tasks that are currently running on any CPU.
+	RTOS_TaskSet		QueuedTasks;				// Tasks that belong to the run queue of any CPU.
+	RTOS_CpuMask		CpuHoldingPen;				// CPUs in a 'holding pen' (CPU's not running any task).
+	RTOS_TaskSet		CpuTasks[RTOS_SMP_CPU_CORES];		// Per CPU run queues, the tasks that belong to each CPU (ready or not).
+#endif
 #if defined(RTOS_INCLUDE_SUSPEND_AND_RESUME)
 	RTOS_TaskSet		SuspendedTasks;				// Suspended tasks.
 #endif
@@ -182,11 +263,24 @@ struct rtos_OS
 	RTOS_RegUInt		TimeshareParallelAllowed;		// The number of time share tasks allowed to run at the same time on different CPUs.
 #endif
 #endif
-	RTOS_Task     		*TaskList[(RTOS_Priority_Highest) + 1];	// A list (really an array) of pointers to all the task structures.
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING) && !defined(RTOS_SMP)
+	RTOS_CycleCount		RunTimeStamp;				// Cycle counter value at the last run time update.
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY) && !defined(RTOS_SMP)
+	uint32_t		IsrEntryStamp;				// Cycle counter value at the entry of the last interrupt.
+#endif
+	// Read mostly.
+	RTOS_Task     		*TaskList[(RTOS_Priority_Highest) + 1] RTOS_SMP_CACHE_ALIGNED;	// A list (really an array) of pointers to all the task structures.
+#if defined(RTOS_SMP)
+	RTOS_TaskSet		TasksAllowed[RTOS_SMP_CPU_CORES]; 	// Tasks allowed to run on this particular core.
+	RTOS_CpuMask		Cpus;					// A bitmap of all CPUs.
+	RTOS_CpuMutex		OSLock RTOS_SMP_CACHE_ALIGNED;		// Global lock to prevent access of OS structures from other CPUs.
+#endif
+	// Cold.
 #if defined(RTOS_SUPPORT_SLEEP)
-	RTOS_Task     		*Sleepers[(RTOS_Priority_Highest) + 1]; // All the sleeping tasks.
+	RTOS_Task     		*Sleepers[(RTOS_Priority_Highest) + 1] RTOS_SMP_CACHE_ALIGNED; // All the sleeping tasks.
 #endif
-};
+} RTOS_CACHE_ALIGNED;
 
 typedef volatile struct rtos_OS RTOS_OS;
 
@@ -195,6 +289,8 @@ extern RTOS_OS RTOS;
 #if defined(RTOS_SMP)
 extern RTOS_RegInt RTOS_RestrictTaskToCpus(RTOS_Task *task, RTOS_CpuMask cpus);
 extern RTOS_CpuMask RTOS_GetAllowedCpus(RTOS_Task *task);
+extern RTOS_RegInt RTOS_SetPreferredCpu(RTOS_Task *task, RTOS_CpuId cpu);
+extern RTOS_CpuId RTOS_GetPreferredCpu(RTOS_Task *task);
 #endif
 
 extern RTOS_Task *RTOS_GetCurrentTask(void);
@@ -210,6 +306,9 @@ struct rtos_EventHandle
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	RTOS_Task_DLList	WaitList;
 #endif
+#if defined(RTOS_SMP)
+	RTOS_CpuMutex		Lock;		// Protects the event (and the object built on it) from other CPUs, see rtos_internals.h.
+#endif
 };
 
 typedef unsigned int RTOS_SemaphoreCount;
@@ -231,26 +330,49 @@ extern RTOS_RegInt  RTOS_PostSemaphore(RTOS_Semaphore *semaphore);
 extern RTOS_RegInt  RTOS_GetSemaphore(RTOS_Semaphore *semaphore, RTOS_Time timeout);
 
 // Structure representing a thread of execution (known as a task in RTOS parlance).
+// The fields the scheduler and the context switch use come first and the ones only needed to create, kill
+// or inspect a task come last, so that scheduling touches as few cache lines of a task as possible.
+// With SMP each task starts on a cache line of its own, so that two CPUs running different tasks do not share lines.
 struct rtos_Task
 {
-	void                	*SP;				// Stack Pointer.
-	void                	*SP0;				// Botton of the stack  (for debugging).
+	void                	*SP;				// Stack Pointer (must be the first field, the context switch code relies on it).
 	RTOS_TaskPriority  	Priority;			// The tasks priority.
+	RTOS_RegInt		Status;				// Task's internal status.
 	RTOS_EventHandle   	*WaitFor;			// Event the task is waiting for.
 	RTOS_Time      		WakeUpTime;			// Time when to wake up.
-	void            	(*Action)(void *);		// The main loop of the task.
-	void            	*Parameter;			// Parameter to Action().
+#if defined(RTOS_SMP)
+	RTOS_CpuId		Cpu;				// The CPU the task is running on.
+	RTOS_CpuId		HomeCpu;			// The CPU whose run queue the task belongs to (normally the CPU it last ran on).
+#endif
 #if defined(RTOS_SUPPORT_TIMESHARE)
+	RTOS_RegInt		IsTimeshared;			// Is this task time sliced.
 	RTOS_Time		TicksToRun;			// Ticks remaining from the current timeslice.
-	RTOS_Time		TimeSliceTicks;			// The length of a full time slice for this task.
 	RTOS_Time		TimeWatermark;			// A time when the task was last seen running.
 	RTOS_Task_DLLink	Link;
-	RTOS_RegInt		IsTimeshared;			// Is this task time sliced.
+#endif
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	RTOS_RunTime		RunTime;			// Accumulated run time in cycle counter units.
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	RTOS_RegUInt		WakeupPending;			// Readied by an ISR, but not dispatched yet.
+	uint32_t		WakeupStamp;			// Entry time of the ISR that readied the task.
+#endif
+	// Cold.
+	void                	*SP0;				// Botton of the stack  (for debugging).
+	void            	(*Action)(void *);		// The main loop of the task.
+	void            	*Parameter;			// Parameter to Action().
+#if defined(RTOS_SUPPORT_TIMESHARE)
+	RTOS_Time		TimeSliceTicks;			// The length of a full time slice for this task.
 #endif
 #if defined(RTOS_SMP)
-	RTOS_CpuId		Cpu;				// The CPU the task is running on.
+	RTOS_CpuId		PreferredCpu;			// Soft affinity hint, RTOS_CPUID_NO_CPU if there is none.
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	RTOS_LatencyHistogram	WakeupLatency;			// Time from ISR entry to the task being dispatched.
+#endif
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+	unsigned long		StackCapacity;			// Size of the stack in stack items (for stack checking).
 #endif
-	RTOS_RegInt		Status;				// Task's internal status.
 #if defined(RTOS_TARGET_SPECIFIC_TASK_DATA)
 RTOS_TARGET_SPECIFIC_TASK_DATA 
 #endif
@@ -258,18 +380,33 @@ RTOS_TARGET_SPECIFIC_TASK_DATA
 #if defined(RTOS_TASK_NAME_LENGTH)
 	char			TaskName[RTOS_TASK_NAME_LENGTH];
 #endif
-};
+} RTOS_SMP_CACHE_ALIGNED;
 
 #define RTOS_TIMEOUT_FOREVER (~(RTOS_Time)0)
 
 #include <rtos_target.h>
 
+// The target port supplies rtos_TargetEnterCriticalSection() and rtos_TargetExitCriticalSection(),
+// the OS and applications use them through RTOS_EnterCriticalSection() and RTOS_ExitCriticalSection().
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+#if !defined(RTOS_CRITICAL_STATE_WAS_ENABLED)
+#error Critical section profiling needs RTOS_CRITICAL_STATE_WAS_ENABLED() defined by the target.
+#endif
+extern void rtos_CriticalSectionEntered(RTOS_Critical_State saved);
+extern void rtos_CriticalSectionLeaving(RTOS_Critical_State saved);
+#define RTOS_EnterCriticalSection(X)	do { rtos_TargetEnterCriticalSection(X); rtos_CriticalSectionEntered(X); } while(0)
+#define RTOS_ExitCriticalSection(X)	do { rtos_CriticalSectionLeaving(X); rtos_TargetExitCriticalSection(X); } while(0)
+#else
+#define RTOS_EnterCriticalSection(X)	rtos_TargetEnterCriticalSection(X)
+#define RTOS_ExitCriticalSection(X)	rtos_TargetExitCriticalSection(X)
+#endif
+
 #if !defined(RTOS_INTERRUPT_CONTEXT_TRACKED_BY_HARDWARE_ONLY)
 #if !defined(RTOS_IsInsideIsr)
 #if defined(RTOS_SMP)
 // For bring up only.
 // This definition does not always work. For multi-core operation define something more reliable in the actual target specific code.
-#define RTOS_IsInsideIsr() (0 != RTOS.InterruptNesting[RTOS_CurrentCpu()])
+#define RTOS_IsInsideIsr() (0 != RTOS.PerCpu[RTOS_CurrentCpu()].InterruptNesting)
 #else
 #define RTOS_IsInsideIsr() (0 != RTOS.InterruptNesting)
 #endif
@@ -280,10 +417,22 @@ RTOS_TARGET_SPECIFIC_TASK_DATA
 // invoke the scheduler before each return.
 // Other targets have multiple entry points for interrupts and need to invoke the scheduler explicitly
 // if needed.
+// The scheduler is only invoked (or signalled) if the set of ready tasks has changed in a way that matters:
+// the calling task cannot run anymore or it is outranked by a ready task (on SMP: a ready task has a CPU to preempt).
+// Waking up a lower priority task does not cost a trap.
+#if defined(RTOS_SMP)
+extern RTOS_RegInt rtos_IsPreemptionNeeded(void);
+#else
+#define rtos_IsPreemptionNeeded() 									\
+	((0 == RTOS.CurrentTask)									\
+	|| !RTOS_TaskSet_IsMember(RTOS.ReadyToRunTasks, RTOS.CurrentTask->Priority)			\
+	|| (RTOS_FIND_HIGHEST(RTOS.ReadyToRunTasks) > RTOS.CurrentTask->Priority))
+#endif
+
 #if defined(RTOS_SIGNAL_SCHEDULER_FROM_INTERRUPT)
 
 #define RTOS_REQUEST_RESCHEDULING() 			\
-if (!RTOS_SchedulerIsLocked())					\
+if ((!RTOS_SchedulerIsLocked()) && rtos_IsPreemptionNeeded())	\
 { 												\
 	if (!RTOS_IsInsideIsr())					\
 	{											\
@@ -297,10 +446,25 @@ if (!RTOS_SchedulerIsLocked())					\
 
 #else
 
-#define RTOS_REQUEST_RESCHEDULING() 						\
-if ((!RTOS_IsInsideIsr()) && (!RTOS_SchedulerIsLocked()))	\
-{															\
-		RTOS_INVOKE_SCHEDULER();							\
+// Inside an ISR the request is only recorded, the port runs the scheduler when the interrupt returns
+// (see rtos_IsRescheduleNeeded()). SMP ports always run the scheduler when an interrupt returns.
+#if defined(RTOS_SMP)
+#define rtos_RequestReschedulingFromIsr()
+#else
+#define rtos_RequestReschedulingFromIsr() do { if (rtos_IsPreemptionNeeded()) { RTOS.RescheduleNeeded = 1; } } while (0)
+#endif
+
+#define RTOS_REQUEST_RESCHEDULING() 				\
+if (!RTOS_IsInsideIsr())					\
+{								\
+	if ((!RTOS_SchedulerIsLocked()) && rtos_IsPreemptionNeeded())	\
+	{							\
+		RTOS_INVOKE_SCHEDULER();			\
+	}							\
+}								\
+else								\
+{								\
+	rtos_RequestReschedulingFromIsr();			\
 }
 
 #endif
@@ -317,6 +481,8 @@ if ((!RTOS_IsInsideIsr()) && (!RTOS_SchedulerIsLocked()))	\
 // or from inside a critical section.
 extern RTOS_RegInt RTOS_CreateTask(RTOS_Task *task, const char *name, RTOS_TaskPriority priority, void *sp0, unsigned long stackCapacity, void (*f)(void *), void *param);
 extern RTOS_Task *RTOS_TaskFromPriority(RTOS_TaskPriority priority);
+// The set must not be empty (the result is target specific for an empty set).
+extern RTOS_TaskPriority RTOS_GetHighestPriorityInSet(RTOS_TaskSet taskSet);
 
 #if defined(RTOS_SUPPORT_TIMESHARE)
 // This function should be called either during initialization (before the OS is running)
@@ -373,6 +539,139 @@ extern RTOS_RegInt RTOS_ResumeTask(RTOS_Task *task);
 extern RTOS_RegInt RTOS_WakeupTask(RTOS_Task *task);
 #endif
 
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+#if !defined(RTOS_STACK_PAINT_PATTERN)
+#define RTOS_STACK_PAINT_PATTERN ((RTOS_StackItem_t)0xA5A5A5A5)
+#endif
+extern unsigned long RTOS_GetStackHighWater(RTOS_Task *task);
+
+#if defined(RTOS_INCLUDE_DELAY)
+#if !defined(RTOS_STACK_CHECK_PERIOD)
+#define RTOS_STACK_CHECK_PERIOD (RTOS_TICKS_PER_SECOND)
+#endif
+#if !defined(RTOS_STACK_CHECK_THRESHOLD)
+#define RTOS_STACK_CHECK_THRESHOLD 16	/* In stack items. */
+#endif
+#if !defined(RTOS_STACK_CHECK_FAILED)
+#define RTOS_STACK_CHECK_FAILED(TASK, FREE) RTOS_ASSERT(0)
+#endif
+extern void RTOS_DefaultStackCheckFunction(void *p);
+#endif
+#endif
+
+#if defined(RTOS_USE_CYCLE_COUNTER)
+#if !defined(RTOS_READ_CYCLE_COUNTER)
+#error Run time accounting and tracing need a cycle counter, RTOS_READ_CYCLE_COUNTER() is not defined by this target.
+#endif
+#endif
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+// A consistent copy of the run time of all tasks.
+struct rtos_RunTimeSnapshot
+{
+	RTOS_CycleCount		Timestamp;					// Cycle counter value when the snapshot was taken.
+	RTOS_RunTime		TaskRunTime[(RTOS_Priority_Highest) + 1];	// Run time of each task by priority, 0 if there is no such task.
+#if defined(RTOS_SMP)
+	RTOS_RunTime		CpuIdleTime[RTOS_SMP_CPU_CORES];		// Idle time of each CPU.
+#endif
+};
+typedef struct rtos_RunTimeSnapshot RTOS_RunTimeSnapshot;
+
+extern RTOS_RunTime RTOS_GetTaskRunTime(RTOS_Task *task);
+extern void RTOS_GetRunTimeSnapshot(RTOS_RunTimeSnapshot *snapshot);
+#endif
+
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+// Summary of a latency histogram, all values in cycle counter units.
+// P99 is an upper bound: the top of the histogram bucket containing the 99th percentile (but never above Max).
+struct rtos_LatencyStatistics
+{
+	uint32_t		Count;
+	uint32_t		Min;
+	uint32_t		Max;
+	uint32_t		P99;
+};
+typedef struct rtos_LatencyStatistics RTOS_LatencyStatistics;
+
+extern RTOS_RegInt RTOS_GetWakeupLatencyHistogram(RTOS_Task *task, RTOS_LatencyHistogram *histogram);
+extern RTOS_RegInt RTOS_GetWakeupLatency(RTOS_Task *task, RTOS_LatencyStatistics *statistics);
+extern RTOS_RegInt RTOS_ResetWakeupLatency(RTOS_Task *task);
+extern uint32_t RTOS_LatencyPercentile(const RTOS_LatencyHistogram *histogram, uint32_t percent);
+#endif
+
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+#if !defined(RTOS_CRITICAL_PROFILE_SITES)
+#define RTOS_CRITICAL_PROFILE_SITES 64
+#endif
+
+#if ((RTOS_CRITICAL_PROFILE_SITES) & ((RTOS_CRITICAL_PROFILE_SITES) - 1)) != 0
+#error RTOS_CRITICAL_PROFILE_SITES must be a power of 2.
+#endif
+
+// The longest time interrupts were kept disabled by critical sections entered at a particular place in the code.
+// Only outermost critical sections entered with interrupts enabled are measured, times are in cycle counter units.
+struct rtos_CriticalSectionSite
+{
+	uintptr_t		Site;		// Return address of the call right after RTOS_EnterCriticalSection().
+	uint32_t		MaxCycles;
+	uint32_t		Count;
+};
+typedef struct rtos_CriticalSectionSite RTOS_CriticalSectionSite;
+
+// Copy at most maxSites entries, returns the number copied.
+extern RTOS_RegUInt RTOS_GetCriticalSectionProfile(RTOS_CriticalSectionSite *sites, RTOS_RegUInt maxSites);
+extern uint32_t RTOS_GetCriticalSectionProfileDropped(void);
+extern void RTOS_ResetCriticalSectionProfile(void);
+
+#if defined(RTOS_SMP)
+// Time spent spinning on the OS lock on a CPU.
+struct rtos_LockSpinStatistics
+{
+	uint64_t		TotalCycles;
+	uint32_t		MaxCycles;
+	uint32_t		Count;
+};
+typedef struct rtos_LockSpinStatistics RTOS_LockSpinStatistics;
+
+extern RTOS_RegInt RTOS_GetLockSpinStatistics(RTOS_CpuId cpu, RTOS_LockSpinStatistics *statistics);
+#endif
+#endif
+
+#if defined(RTOS_INCLUDE_TRACE)
+#include <rtos_trace.h>
+
+#if !defined(RTOS_TRACE_BUFFER_SIZE)
+#define RTOS_TRACE_BUFFER_SIZE 256	/* Events per CPU. */
+#endif
+
+#if ((RTOS_TRACE_BUFFER_SIZE) & ((RTOS_TRACE_BUFFER_SIZE) - 1)) != 0
+#error RTOS_TRACE_BUFFER_SIZE must be a power of 2.
+#endif
+
+#if defined(RTOS_SMP)
+#define RTOS_TRACE_CPUS (RTOS_SMP_CPU_CORES)
+#else
+#define RTOS_TRACE_CPUS 1
+#endif
+
+// The trace buffer of a single CPU, see rtos_trace.h for the format.
+struct rtos_TraceBuffer
+{
+	RTOS_TraceHeader	Header;
+	RTOS_TraceRecord	Events[RTOS_TRACE_BUFFER_SIZE];
+};
+typedef volatile struct rtos_TraceBuffer RTOS_TraceBuffer;
+
+// The buffers can be dumped with a debugger (or by the application) and decoded on the host.
+extern RTOS_TraceBuffer RTOS_TraceBuffers[RTOS_TRACE_CPUS];
+
+// Record an event in the current CPU's trace buffer, must be called with interrupts disabled.
+extern void RTOS_TraceEvent(uint32_t type, uint32_t extra, uint32_t data);
+#define RTOS_TRACE(TYPE, EXTRA, DATA) RTOS_TraceEvent((TYPE), (uint32_t)(EXTRA), (uint32_t)(uintptr_t)(DATA))
+#else
+#define RTOS_TRACE(TYPE, EXTRA, DATA)
+#endif
+
 #if !defined(RTOS_INLINE)
 #define RTOS_INLINE
 #endif
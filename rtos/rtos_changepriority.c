@@ -83,6 +83,14 @@ RTOS_RegInt RTOS_ChangePriority(RTOS_Task *task, RTOS_TaskPriority targetPriorit
 				RTOS_TaskSet_AddMember(RTOS.TasksAllowed[i], targetPriority);
 			}
 		}
+
+		if ((RTOS_CPUID_NO_CPU) != task->HomeCpu)
+		{
+			RTOS_TaskSet_RemoveMember(RTOS.CpuTasks[task->HomeCpu], oldPriority);
+			RTOS_TaskSet_AddMember(RTOS.CpuTasks[task->HomeCpu], targetPriority);
+			RTOS_TaskSet_RemoveMember(RTOS.QueuedTasks, oldPriority);
+			RTOS_TaskSet_AddMember(RTOS.QueuedTasks, targetPriority);
+		}
 #endif
 		if (RTOS_TaskSet_IsMember(RTOS.ReadyToRunTasks,  oldPriority))
 		{
@@ -93,8 +101,11 @@ RTOS_RegInt RTOS_ChangePriority(RTOS_Task *task, RTOS_TaskPriority targetPriorit
 		{	
 			if ((0 != task->WaitFor) && (RTOS_TaskSet_IsMember(task->WaitFor->TasksWaiting,  oldPriority)))
 			{
+				// The set must not look empty even for a moment to someone holding only the event's lock.
+				rtos_LockObject(&(task->WaitFor->Lock));
 				RTOS_TaskSet_RemoveMember(task->WaitFor->TasksWaiting, oldPriority);
 				RTOS_TaskSet_AddMember(task->WaitFor->TasksWaiting, targetPriority);
+				rtos_UnlockObject(&(task->WaitFor->Lock));
 			}
 #if defined(RTOS_INCLUDE_SUSPEND_AND_RESUME)
 			else if (RTOS_TaskSet_IsMember(RTOS.SuspendedTasks,  oldPriority))
@@ -134,11 +145,8 @@ RTOS_RegInt RTOS_ChangePriority(RTOS_Task *task, RTOS_TaskPriority targetPriorit
 
 	RTOS_ExitCriticalSection(saved_state);
 
-    	if ((!RTOS_IsInsideIsr()) && (!RTOS_SchedulerIsLocked()))
-    	{
-		RTOS_INVOKE_SCHEDULER();
-	}
-	
+	RTOS_REQUEST_RESCHEDULING();
+
 	return result;
 }
 
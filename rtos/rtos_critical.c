@@ -0,0 +1,230 @@
+#include <rtos.h>
+#include <rtos_internals.h>
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+// Critical section profiling.
+// RTOS_EnterCriticalSection() and RTOS_ExitCriticalSection() call the functions below around the target's own
+// implementation. Only the outermost critical section is timed (the one entered with interrupts enabled), from the
+// point the section was entered (on SMP: the OS lock acquired) to the point it is about to be left.
+// The result is attributed to the return address of rtos_CriticalSectionEntered(), i.e. to the code right after the
+// RTOS_EnterCriticalSection() that opened the section, so that it can be looked up in the map file or with addr2line.
+// If a task switch happens inside a critical section the time is charged to the section that disabled interrupts.
+// Code running with interrupts disabled by the hardware (ISRs) is not measured, neither is the profiling overhead.
+
+#if defined(RTOS_SMP)
+#define RTOS_CRITICAL_CPUS (RTOS_SMP_CPU_CORES)
+#define rtos_CriticalCpu() RTOS_CurrentCpu()
+#else
+#define RTOS_CRITICAL_CPUS 1
+#define rtos_CriticalCpu() 0
+#endif
+
+struct rtos_OpenCriticalSection
+{
+	uintptr_t	Site;
+	uint32_t	Start;
+	uint32_t	Open;
+};
+
+static struct rtos_OpenCriticalSection rtos_OpenSections[RTOS_CRITICAL_CPUS];
+
+// Open addressing hash table of call sites, only accessed inside critical sections.
+static RTOS_CriticalSectionSite rtos_CriticalSites[RTOS_CRITICAL_PROFILE_SITES];
+static uint32_t rtos_CriticalSitesDropped;	// Samples not recorded because the table was full.
+
+#if defined(RTOS_SMP)
+static volatile RTOS_LockSpinStatistics rtos_LockSpin[RTOS_SMP_CPU_CORES];
+#endif
+
+void __attribute__((noinline)) rtos_CriticalSectionEntered(RTOS_Critical_State saved)
+{
+	struct rtos_OpenCriticalSection *open;
+
+	if (RTOS_CRITICAL_STATE_WAS_ENABLED(saved))
+	{
+		open = &rtos_OpenSections[rtos_CriticalCpu()];
+		open->Site = (uintptr_t)__builtin_return_address(0);
+		open->Open = 1;
+		open->Start = (uint32_t)RTOS_READ_CYCLE_COUNTER();
+	}
+}
+
+void rtos_CriticalSectionLeaving(RTOS_Critical_State saved)
+{
+	uint32_t now = (uint32_t)RTOS_READ_CYCLE_COUNTER();
+	uint32_t elapsed;
+	uint32_t i;
+	uint32_t n;
+	struct rtos_OpenCriticalSection *open;
+	RTOS_CriticalSectionSite *site;
+
+	if (!RTOS_CRITICAL_STATE_WAS_ENABLED(saved))
+	{
+		return;
+	}
+
+	open = &rtos_OpenSections[rtos_CriticalCpu()];
+
+	// A task that starts running for the first time does not leave the section its predecessor entered.
+	if (0 == open->Open)
+	{
+		return;
+	}
+
+	open->Open = 0;
+	elapsed = now - open->Start;
+
+	i = (uint32_t)((open->Site >> 2) ^ (open->Site >> 9));
+
+	for (n = 0; n < (RTOS_CRITICAL_PROFILE_SITES); n++)
+	{
+		site = &rtos_CriticalSites[(i + n) & ((RTOS_CRITICAL_PROFILE_SITES) - 1)];
+
+		if ((site->Site == open->Site) || (0 == site->Site))
+		{
+			site->Site = open->Site;
+
+			if (elapsed > site->MaxCycles)
+			{
+				site->MaxCycles = elapsed;
+			}
+
+			site->Count++;
+			return;
+		}
+	}
+
+	rtos_CriticalSitesDropped++;
+}
+
+// Copy at most maxSites used entries of the call site table, returns the number of entries copied.
+RTOS_RegUInt RTOS_GetCriticalSectionProfile(RTOS_CriticalSectionSite *sites, RTOS_RegUInt maxSites)
+{
+	RTOS_RegUInt i;
+	RTOS_RegUInt count = 0;
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != sites);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == sites)
+	{
+		return 0;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	for (i = 0; (i < (RTOS_CRITICAL_PROFILE_SITES)) && (count < maxSites); i++)
+	{
+		if (0 != rtos_CriticalSites[i].Site)
+		{
+			sites[count].Site = rtos_CriticalSites[i].Site;
+			sites[count].MaxCycles = rtos_CriticalSites[i].MaxCycles;
+			sites[count].Count = rtos_CriticalSites[i].Count;
+			count++;
+		}
+	}
+	RTOS_ExitCriticalSection(saved_state);
+
+	return count;
+}
+
+// The number of samples lost because RTOS_CRITICAL_PROFILE_SITES was too small.
+uint32_t RTOS_GetCriticalSectionProfileDropped(void)
+{
+	return rtos_CriticalSitesDropped;
+}
+
+void RTOS_ResetCriticalSectionProfile(void)
+{
+	RTOS_RegUInt i;
+	RTOS_SavedCriticalState(saved_state);
+
+	RTOS_EnterCriticalSection(saved_state);
+	for (i = 0; i < (RTOS_CRITICAL_PROFILE_SITES); i++)
+	{
+		rtos_CriticalSites[i].Site = 0;
+		rtos_CriticalSites[i].MaxCycles = 0;
+		rtos_CriticalSites[i].Count = 0;
+	}
+	rtos_CriticalSitesDropped = 0;
+
+#if defined(RTOS_SMP)
+	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
+	{
+		rtos_LockSpin[i].TotalCycles = 0;
+		rtos_LockSpin[i].MaxCycles = 0;
+		rtos_LockSpin[i].Count = 0;
+	}
+#endif
+	RTOS_ExitCriticalSection(saved_state);
+}
+
+#if defined(RTOS_SMP)
+// Each CPU only updates its own entry, the OS lock is already held when this is called.
+void rtos_AccountLockSpin(uint32_t cycles)
+{
+	volatile RTOS_LockSpinStatistics *spin = &rtos_LockSpin[RTOS_CurrentCpu()];
+
+	spin->TotalCycles += cycles;
+
+	if (cycles > spin->MaxCycles)
+	{
+		spin->MaxCycles = cycles;
+	}
+
+	spin->Count++;
+}
+
+RTOS_RegInt RTOS_GetLockSpinStatistics(RTOS_CpuId cpu, RTOS_LockSpinStatistics *statistics)
+{
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != statistics);
+	RTOS_ASSERT(cpu < (RTOS_SMP_CPU_CORES));
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if ((0 == statistics) || (cpu >= (RTOS_SMP_CPU_CORES)))
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	statistics->TotalCycles = rtos_LockSpin[cpu].TotalCycles;
+	statistics->MaxCycles = rtos_LockSpin[cpu].MaxCycles;
+	statistics->Count = rtos_LockSpin[cpu].Count;
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_OK;
+}
+#endif
+
+#endif
@@ -69,7 +69,9 @@ RTOS_RegInt RTOS_WaitForEvent(RTOS_EventHandle *event, RTOS_Time timeout)
 
 	thisTask = RTOS_CURRENT_TASK();
 
+	rtos_LockObject(&(event->Lock));
 	rtos_WaitForEvent(event, thisTask, timeout);
+	rtos_UnlockObject(&(event->Lock));
 
 	RTOS_ExitCriticalSection(saved_state);
 
@@ -103,7 +105,9 @@ RTOS_RegInt RTOS_SignalEvent(RTOS_EventHandle *event)
 #endif
 
 	RTOS_EnterCriticalSection(saved_state);
+	rtos_LockObject(&(event->Lock));
 	result = rtos_SignalEvent(event);
+	rtos_UnlockObject(&(event->Lock));
 	RTOS_ExitCriticalSection(saved_state);
 
 	RTOS_REQUEST_RESCHEDULING();
@@ -48,6 +48,13 @@ extern "C" {
 
 // This function must be defined by the target port.
 extern void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity);
+// Targets that keep per task state outside of the task's stack frame may define rtos_TargetTaskKilled(TASK) in rtos_target.h,
+// it is called inside a critical section when a task is killed.
+
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+// Fill the stack with RTOS_STACK_PAINT_PATTERN, to be called by rtos_TargetInitializeTask().
+extern void rtos_PaintStack(RTOS_Task *task, unsigned long stackCapacity);
+#endif
 
 // Initialization.
 extern RTOS_RegInt rtos_CreateTask(RTOS_Task *task, void *sp0, unsigned long stackCapacity, void (*f)(void *), void *param);
@@ -68,18 +75,60 @@ extern RTOS_RegInt rtos_RegisterTask(RTOS_Task *task, RTOS_TaskPriority priority
 extern RTOS_RegInt rtos_MapStatusToReturnValue(RTOS_RegInt status);
 #endif
 
-#if defined(RTOS_INCLUDE_WAKEUP)
+#if defined(RTOS_INCLUDE_WAKEUP) || defined(RTOS_INCLUDE_SUSPEND_AND_RESUME)
 extern RTOS_RegInt rtos_WakeupTask(RTOS_Task *task);
 #endif
 
 #if defined(RTOS_SMP)
-#define RTOS_CURRENT_TASK() RTOS.CurrentTasks[RTOS_CurrentCpu()]
-#define rtos_IsCpuInsideIsr(CPU) (0 != RTOS.InterruptNesting[(CPU)])
+// The per CPU data of the CPU executing the code, only valid with interrupts disabled (otherwise the caller could be moved to another CPU).
+// Targets which can keep a pointer to it in a register of each CPU define rtos_ThisCpu() in rtos_target.h.
+#if !defined(rtos_ThisCpu)
+#define rtos_ThisCpu() (&(RTOS.PerCpu[RTOS_CurrentCpu()]))
+#endif
+#define RTOS_CURRENT_TASK() (rtos_ThisCpu()->CurrentTask)
+#define rtos_IsCpuInsideIsr(CPU) (0 != RTOS.PerCpu[(CPU)].InterruptNesting)
 // extern RTOS_RegInt rtos_TaskForceInterrupted(RTOS_Task *task);
 extern void rtos_RestrictPriorityToCpus(RTOS_TaskPriority priority, RTOS_CpuMask cpus);
+extern void rtos_RemoveFromRunQueues(RTOS_Task *task);
+extern RTOS_CpuMask rtos_CpusToReschedule(RTOS_CpuId thisCpu);
+#if defined(RTOS_SUPPORT_TIMESHARE)
+extern RTOS_CpuMask rtos_ExpiredTimeshareCpus(RTOS_CpuId thisCpu);
+#endif
 
 #else
 #define RTOS_CURRENT_TASK() RTOS.CurrentTask
+
+// Ports call this before returning from an interrupt and skip the scheduler if nothing the current task cares about has changed.
+#define rtos_IsRescheduleNeeded() (0 != RTOS.RescheduleNeeded)
+#endif
+
+#if defined(RTOS_SMP)
+// Per object locks.
+// Semaphores, events and queues have a lock of their own, so that operations on unrelated objects on different CPUs
+// do not contend for RTOS.OSLock. OSLock is only needed when the operation changes the state of a task
+// (ready to run, waiting, sleeping), that is when a task has to block or has to be woken up.
+//
+// Lock ordering: RTOS.OSLock -> queue lock -> event (semaphore) lock.
+// Interrupt handlers run with OSLock held, so an object lock is never held while waiting for OSLock.
+// An operation that finds it needs OSLock after all releases the object lock, enters a critical section and
+// takes the object lock again (then it has to check the state of the object again).
+//
+// A task is only added to TasksWaiting with both OSLock and the event lock held. Waiters can be removed
+// with OSLock alone (time-outs, RTOS_WakeupTask() etc.), so a fast path holding just the event lock can safely
+// assume there are no waiters if it finds TasksWaiting empty.
+//
+// Object locks are taken with interrupts disabled, but RTOS_EnterCriticalSection() cannot be nested inside
+// rtos_EnterObjectLock() (on some targets it does not take OSLock when interrupts are already disabled).
+#define rtos_EnterObjectLock(LOCK, X)	do { rtos_disableInterrupts(X); rtos_LockCpuMutex(LOCK); } while(0)
+#define rtos_ExitObjectLock(LOCK, X)	do { rtos_UnlockCpuMutex(LOCK); rtos_restoreInterrupts(X); } while(0)
+#define rtos_LockObject(LOCK)		rtos_LockCpuMutex(LOCK)	/* Already in a critical section. */
+#define rtos_UnlockObject(LOCK)		rtos_UnlockCpuMutex(LOCK)
+#else
+// Without SMP the critical section protects everything.
+#define rtos_EnterObjectLock(LOCK, X)	RTOS_EnterCriticalSection(X)
+#define rtos_ExitObjectLock(LOCK, X)	RTOS_ExitCriticalSection(X)
+#define rtos_LockObject(LOCK)
+#define rtos_UnlockObject(LOCK)
 #endif
 
 // These should only be called by the target port or other OS components.
@@ -88,6 +137,38 @@ extern void rtos_Scheduler(void);
 extern void rtos_SchedulerForYield(void);
 extern void rtos_RunTask(void);
 
+#if defined(RTOS_SIMULATION) && defined(RTOS_SUPPORT_SLEEP)
+// The number of ticks that can be skipped without missing the wake-up of a sleeping task, called from a critical section.
+extern RTOS_Time rtos_IdleTicksBeforeWakeUp(void);
+#endif
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+// Charge the time elapsed since the last update on this CPU to 'task', called by the scheduler.
+extern void rtos_AccountRunTime(RTOS_Task *task);
+#endif
+
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+// To be called by the target port at the entry of every interrupt handler.
+#if defined(RTOS_SMP)
+#define rtos_StampIsrEntry() (rtos_ThisCpu()->IsrEntryStamp = (uint32_t)RTOS_READ_CYCLE_COUNTER())
+#else
+#define rtos_StampIsrEntry() (RTOS.IsrEntryStamp = (uint32_t)RTOS_READ_CYCLE_COUNTER())
+#endif
+// Called when a task is made ready to run, and when it is dispatched.
+extern void rtos_MarkWakeup(RTOS_Task *task);
+extern void rtos_RecordWakeupLatency(RTOS_Task *task);
+#endif
+
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING) && defined(RTOS_SMP)
+// Called by the target port with the number of cycles spent waiting for the OS lock.
+extern void rtos_AccountLockSpin(uint32_t cycles);
+#endif
+
+#if defined(RTOS_INCLUDE_TRACE)
+// Record a context switch from 'previous' to 'next' (either can be 0), called by the scheduler.
+extern void rtos_TraceContextSwitch(RTOS_Task *previous, RTOS_Task *next);
+#endif
+
 // Only to be called by OS components.
 extern RTOS_RegInt rtos_SignalEvent(RTOS_EventHandle *event);
 extern void rtos_WaitForEvent(RTOS_EventHandle *event, RTOS_Task *task, RTOS_Time timeout);
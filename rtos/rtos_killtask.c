@@ -122,6 +122,9 @@ RTOS_RegInt RTOS_KillTask(RTOS_Task *task)
 #endif
 		RTOS.TaskList[priority] = 0;
 		task->Status = RTOS_TASK_STATUS_KILLED;
+#if defined(rtos_TargetTaskKilled)
+		rtos_TargetTaskKilled(task);
+#endif
 
 	}
 
@@ -0,0 +1,199 @@
+#include <rtos.h>
+#include <rtos_internals.h>
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+// Interrupt to task wake-up latency.
+// The target port stamps the entry of every interrupt (rtos_StampIsrEntry()), when an ISR makes a task ready to run
+// the stamp is copied to the task, and when the task is next dispatched by the scheduler the elapsed time
+// is added to the task's histogram.
+// Only wake-ups from interrupt context are measured (with RTOS_USE_TIMER_TASK timeouts are handled by a task and
+// are not measured). If interrupts nest, the stamp is the entry time of the innermost interrupt.
+// On targets with separate vectors for each interrupt (ARM-Mx) only the port's own handlers are stamped,
+// application interrupt handlers that wake up tasks should call rtos_StampIsrEntry() first thing.
+// On SMP targets where each CPU has its own cycle counter, wake-ups dispatched on another CPU are only approximate.
+
+void rtos_MarkWakeup(RTOS_Task *task)
+{
+	if (RTOS_IsInsideIsr())
+	{
+#if defined(RTOS_SMP)
+		task->WakeupStamp = RTOS.PerCpu[RTOS_CurrentCpu()].IsrEntryStamp;
+#else
+		task->WakeupStamp = RTOS.IsrEntryStamp;
+#endif
+		task->WakeupPending = 1;
+	}
+}
+
+void rtos_RecordWakeupLatency(RTOS_Task *task)
+{
+	uint32_t latency;
+	uint32_t bucket;
+	volatile RTOS_LatencyHistogram *histogram = &(task->WakeupLatency);
+
+	latency = (uint32_t)RTOS_READ_CYCLE_COUNTER() - task->WakeupStamp;
+	task->WakeupPending = 0;
+
+	bucket = (latency < 2) ? 0 : (uint32_t)(31 - __builtin_clz(latency));
+
+	if (bucket >= (RTOS_LATENCY_BUCKETS))
+	{
+		bucket = (RTOS_LATENCY_BUCKETS) - 1;
+	}
+
+	histogram->Buckets[bucket]++;
+
+	if ((0 == histogram->Count) || (latency < histogram->Min))
+	{
+		histogram->Min = latency;
+	}
+
+	if (latency > histogram->Max)
+	{
+		histogram->Max = latency;
+	}
+
+	histogram->Count++;
+}
+
+// The upper bound of the bucket containing the given percentile, clipped to the maximum seen.
+uint32_t RTOS_LatencyPercentile(const RTOS_LatencyHistogram *histogram, uint32_t percent)
+{
+	uint32_t needed;
+	uint32_t sum = 0;
+	uint32_t i;
+
+	if ((0 == histogram->Count) || (percent > 100))
+	{
+		return 0;
+	}
+
+	// The number of samples at or below the percentile, rounded up (without 64 bit arithmetic).
+	needed = (histogram->Count / 100) * percent + ((histogram->Count % 100) * percent + 99) / 100;
+
+	for (i = 0; i < ((RTOS_LATENCY_BUCKETS) - 1); i++)
+	{
+		sum += histogram->Buckets[i];
+
+		if (sum >= needed)
+		{
+			return (((2UL << i) - 1) < histogram->Max) ? (uint32_t)((2UL << i) - 1) : histogram->Max;
+		}
+	}
+
+	return histogram->Max;
+}
+
+// Copy a consistent snapshot of a task's histogram.
+RTOS_RegInt RTOS_GetWakeupLatencyHistogram(RTOS_Task *task, RTOS_LatencyHistogram *histogram)
+{
+	RTOS_RegUInt i;
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+	RTOS_ASSERT(0 != histogram);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if ((0 == task) || (0 == histogram))
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	// No memcpy(), there may be no C library.
+	RTOS_EnterCriticalSection(saved_state);
+	for (i = 0; i < (RTOS_LATENCY_BUCKETS); i++)
+	{
+		histogram->Buckets[i] = task->WakeupLatency.Buckets[i];
+	}
+	histogram->Count = task->WakeupLatency.Count;
+	histogram->Min = task->WakeupLatency.Min;
+	histogram->Max = task->WakeupLatency.Max;
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_OK;
+}
+
+RTOS_RegInt RTOS_GetWakeupLatency(RTOS_Task *task, RTOS_LatencyStatistics *statistics)
+{
+	RTOS_LatencyHistogram histogram;
+	RTOS_RegInt result;
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != statistics);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == statistics)
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	result = RTOS_GetWakeupLatencyHistogram(task, &histogram);
+
+	if (RTOS_OK == result)
+	{
+		statistics->Count = histogram.Count;
+		statistics->Min = histogram.Min;
+		statistics->Max = histogram.Max;
+		statistics->P99 = RTOS_LatencyPercentile(&histogram, 99);
+	}
+
+	return result;
+}
+
+RTOS_RegInt RTOS_ResetWakeupLatency(RTOS_Task *task)
+{
+	RTOS_RegUInt i;
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == task)
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	for (i = 0; i < (RTOS_LATENCY_BUCKETS); i++)
+	{
+		task->WakeupLatency.Buckets[i] = 0;
+	}
+	task->WakeupLatency.Count = 0;
+	task->WakeupLatency.Min = 0;
+	task->WakeupLatency.Max = 0;
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_OK;
+}
+#endif
@@ -0,0 +1,143 @@
+#include <rtos.h>
+#include <rtos_internals.h>
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+// Per task run time accounting.
+// Every time the scheduler runs the cycles elapsed since the previous run are charged to the task that was running.
+// Time spent in interrupt handlers is charged to the task that was interrupted.
+// The cycle counter is only read with wrap around arithmetics, so the run time must be accounted at least once
+// per wrap around period of the counter on every CPU. On single CPU builds rtos_TimerTick() does it on every tick,
+// with SMP the scheduler runs on every tick anyway.
+
+void rtos_AccountRunTime(RTOS_Task *task)
+{
+	RTOS_CycleCount now;
+	RTOS_CycleCount elapsed;
+#if defined(RTOS_SMP)
+	RTOS_CpuId cpu = RTOS_CurrentCpu();
+#endif
+
+	now = RTOS_READ_CYCLE_COUNTER();
+
+#if defined(RTOS_SMP)
+	elapsed = now - RTOS.PerCpu[cpu].RunTimeStamp;
+	RTOS.PerCpu[cpu].RunTimeStamp = now;
+#else
+	elapsed = now - RTOS.RunTimeStamp;
+	RTOS.RunTimeStamp = now;
+#endif
+
+	// The first call only sets the time stamp.
+	if (!RTOS.IsRunning)
+	{
+		return;
+	}
+
+#if defined(RTOS_SMP)
+	// A CPU without a task is sitting in the holding pen, that is idle time just like running the idle task.
+	if ((0 == task) || (RTOS_Priority_Idle == task->Priority))
+	{
+		RTOS.PerCpu[cpu].CpuIdleTime += elapsed;
+	}
+#endif
+
+	if (0 != task)
+	{
+		task->RunTime += elapsed;
+	}
+}
+
+// Retrieve the accumulated run time of a task in cycle counter units.
+// The time the task has been running on another CPU since that CPU last ran the scheduler is not included.
+RTOS_RunTime RTOS_GetTaskRunTime(RTOS_Task *task)
+{
+	RTOS_RunTime runTime;
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == task)
+	{
+		return 0;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	rtos_AccountRunTime(RTOS_CURRENT_TASK());	// Bring the calling task up to date.
+	runTime = task->RunTime;
+	RTOS_ExitCriticalSection(saved_state);
+
+	return runTime;
+}
+
+// Take a snapshot of the run time of all tasks (and the idle time of all CPUs on SMP systems).
+// Two snapshots taken some time apart give the CPU load of each task in the interval.
+void RTOS_GetRunTimeSnapshot(RTOS_RunTimeSnapshot *snapshot)
+{
+	RTOS_TaskPriority i;
+	RTOS_Task *task;
+#if defined(RTOS_SMP)
+	RTOS_CpuId cpu;
+#endif
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != snapshot);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == snapshot)
+	{
+		return;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+
+	rtos_AccountRunTime(RTOS_CURRENT_TASK());
+
+	for (i = 0; i <= RTOS_Priority_Highest; i++)
+	{
+		task = RTOS.TaskList[i];
+		snapshot->TaskRunTime[i] = (0 != task) ? task->RunTime : 0;
+	}
+
+#if defined(RTOS_SMP)
+	for (cpu = 0; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+	{
+		snapshot->CpuIdleTime[cpu] = RTOS.PerCpu[cpu].CpuIdleTime;
+	}
+	snapshot->Timestamp = RTOS.PerCpu[RTOS_CurrentCpu()].RunTimeStamp;
+#else
+	snapshot->Timestamp = RTOS.RunTimeStamp;
+#endif
+
+	RTOS_ExitCriticalSection(saved_state);
+}
+#endif
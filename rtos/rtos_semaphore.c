@@ -42,6 +42,41 @@ RTOS_RegInt RTOS_CreateSemaphore(RTOS_Semaphore *semaphore, RTOS_SemaphoreCount
 	return RTOS_CreateEventHandle(&(semaphore->Event));
 }
 
+// Add one to the count of a semaphore nobody is waiting for.
+// Called with the semaphore locked.
+RTOS_INLINE RTOS_RegInt rtos_IncrementSemaphore(RTOS_Semaphore *semaphore)
+{
+	RTOS_RegInt result = RTOS_OK;
+
+	if ((RTOS_SEMAPHORE_COUNT_MAX) > semaphore->Count)
+	{
+		semaphore->Count++;
+	}
+	else
+	{
+		result = RTOS_ERROR_OVERFLOW;
+	}
+
+	RTOS_TRACE(RTOS_TRACE_EVENT_SEMAPHORE_POST, semaphore->Count, semaphore);
+
+	return result;
+}
+
+// Take one from the count of a semaphore if it is not zero.
+// Called with the semaphore locked.
+RTOS_INLINE RTOS_RegInt rtos_DecrementSemaphore(RTOS_Semaphore *semaphore)
+{
+	if (0 == semaphore->Count)
+	{
+		return 0;
+	}
+
+	semaphore->Count--;
+	RTOS_TRACE(RTOS_TRACE_EVENT_SEMAPHORE_GET, RTOS_OK, semaphore);
+
+	return 1;
+}
+
 RTOS_RegInt RTOS_PostSemaphore(RTOS_Semaphore *semaphore)
 {
 	RTOS_RegInt result = RTOS_OK;
@@ -57,27 +92,37 @@ RTOS_RegInt RTOS_PostSemaphore(RTOS_Semaphore *semaphore)
 	}
 #endif
 
+#if defined(RTOS_SMP)
+	// If nobody is waiting only the count changes, the semaphore's own lock is enough.
+	rtos_EnterObjectLock(&(semaphore->Event.Lock), saved_state);
+
+	if (RTOS_TaskSet_IsEmpty(semaphore->Event.TasksWaiting))
+	{
+		result = rtos_IncrementSemaphore(semaphore);
+		rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
+		return result;
+	}
+
+	rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
+#endif
+
 	RTOS_EnterCriticalSection(saved_state);
+	rtos_LockObject(&(semaphore->Event.Lock));
 
 	if (RTOS_OK == rtos_SignalEvent(&(semaphore->Event)))
 	{
+		RTOS_TRACE(RTOS_TRACE_EVENT_SEMAPHORE_POST, semaphore->Count, semaphore);
+		rtos_UnlockObject(&(semaphore->Event.Lock));
 		RTOS_ExitCriticalSection(saved_state);
 
 		RTOS_REQUEST_RESCHEDULING()
 	}
-    else
-    {
-        if ((RTOS_SEMAPHORE_COUNT_MAX) > semaphore->Count)
-		{
-        		semaphore->Count++;
-		}
-		else
-		{
-			result = RTOS_ERROR_OVERFLOW;
-		}
-
-        RTOS_ExitCriticalSection(saved_state);
-    }
+	else
+	{
+		result = rtos_IncrementSemaphore(semaphore);
+		rtos_UnlockObject(&(semaphore->Event.Lock));
+		RTOS_ExitCriticalSection(saved_state);
+	}
 
 	return result;
 
@@ -85,7 +130,6 @@ RTOS_RegInt RTOS_PostSemaphore(RTOS_Semaphore *semaphore)
 
 RTOS_RegInt RTOS_GetSemaphore(RTOS_Semaphore *semaphore, RTOS_Time timeout)
 {
-    RTOS_RegInt result;
 	volatile RTOS_Task *thisTask;
 	RTOS_RegInt status;
 	RTOS_SavedCriticalState(saved_state);
@@ -100,20 +144,35 @@ RTOS_RegInt RTOS_GetSemaphore(RTOS_Semaphore *semaphore, RTOS_Time timeout)
         	return RTOS_ERROR_OPERATION_NOT_PERMITTED;
 	}
 #endif
-    	RTOS_EnterCriticalSection(saved_state);
+	// Without SMP this is simply the critical section.
+	rtos_EnterObjectLock(&(semaphore->Event.Lock), saved_state);
 
-    	if (0 != semaphore->Count)
-    	{
-        	semaphore->Count--;
-        	RTOS_ExitCriticalSection(saved_state);
-        	return RTOS_OK;
-    	}
+	if (rtos_DecrementSemaphore(semaphore))
+	{
+		rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
+		return RTOS_OK;
+	}
+
+#if defined(RTOS_SMP)
+	// The task may have to wait, start again with OSLock held first (see the lock ordering in rtos_internals.h).
+	rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
+	RTOS_EnterCriticalSection(saved_state);
+	rtos_LockObject(&(semaphore->Event.Lock));
+
+	if (rtos_DecrementSemaphore(semaphore))
+	{
+		rtos_UnlockObject(&(semaphore->Event.Lock));
+		RTOS_ExitCriticalSection(saved_state);
+		return RTOS_OK;
+	}
+#endif
 
 	// Do allow a GetSempahore() operation from inside an ISR  or with the scheduler locked
 	// but only with a zero timeout (i.e. the non-waiting variety), since an ISR cannot sleep,
 	// tasks cannot sleep either if the scheduler is locked.
     	if ((RTOS_IsInsideIsr()) || (RTOS_SchedulerIsLocked()))
     	{
+		rtos_UnlockObject(&(semaphore->Event.Lock));
         	RTOS_ExitCriticalSection(saved_state);
         	return (0 == timeout) ?  RTOS_TIMED_OUT : RTOS_ERROR_OPERATION_NOT_PERMITTED;
     	}
@@ -123,12 +182,14 @@ RTOS_RegInt RTOS_GetSemaphore(RTOS_Semaphore *semaphore, RTOS_Time timeout)
 	if (0 == timeout)
 	{
 		thisTask->Status = RTOS_TASK_STATUS_ACTIVE;
+		rtos_UnlockObject(&(semaphore->Event.Lock));
     		RTOS_ExitCriticalSection(saved_state);
     		return RTOS_TIMED_OUT;
 	}
  
     	rtos_WaitForEvent(&(semaphore->Event), thisTask, timeout);
 
+	rtos_UnlockObject(&(semaphore->Event.Lock));
     	RTOS_ExitCriticalSection(saved_state);
 
     	RTOS_INVOKE_SCHEDULER();
@@ -139,6 +200,8 @@ RTOS_RegInt RTOS_GetSemaphore(RTOS_Semaphore *semaphore, RTOS_Time timeout)
 
 	thisTask->Status = RTOS_TASK_STATUS_ACTIVE;
 
+	RTOS_TRACE(RTOS_TRACE_EVENT_SEMAPHORE_GET, rtos_MapStatusToReturnValue(status), semaphore);
+
     	RTOS_ExitCriticalSection(saved_state);
 
 	return rtos_MapStatusToReturnValue(status);
@@ -160,13 +223,12 @@ RTOS_SemaphoreCount RTOS_PeekSemaphore(RTOS_Semaphore *semaphore)
 	}
 #endif
 	
-	RTOS_EnterCriticalSection(saved_state);
-
 	if (0 != semaphore)
 	{
+		rtos_EnterObjectLock(&(semaphore->Event.Lock), saved_state);
 		count = semaphore->Count;
+		rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
 	}
-	RTOS_ExitCriticalSection(saved_state);
 
 	return count;
 }
@@ -187,9 +249,9 @@ RTOS_RegInt RTOS_ResetSemaphore(RTOS_Semaphore *semaphore)
 	}
 #endif
 
-	RTOS_EnterCriticalSection(saved_state);
+	rtos_EnterObjectLock(&(semaphore->Event.Lock), saved_state);
 	semaphore->Count = 0;
-	RTOS_ExitCriticalSection(saved_state);
+	rtos_ExitObjectLock(&(semaphore->Event.Lock), saved_state);
 
 	return RTOS_OK;
 }
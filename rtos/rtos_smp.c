@@ -26,6 +26,8 @@
 #include <rtos_internals.h>
 
 #if defined(RTOS_SMP)
+static void rtos_MoveToRunQueue(RTOS_Task *task, RTOS_CpuId cpu);
+
 void rtos_RestrictPriorityToCpus(RTOS_TaskPriority priority, RTOS_CpuMask cpus)
 {
 	RTOS_CpuId i;
@@ -100,34 +102,224 @@ RTOS_CpuMask RTOS_GetAllowedCpus(RTOS_Task *task)
 	return cpus;
 }
 
+// Give a task a soft affinity hint: the task is kept in the run queue of the preferred CPU,
+// so every time it becomes ready that CPU gets the first chance to run it (and its data is likely still in that CPU's cache).
+// Unlike RTOS_RestrictTaskToCpus() this does not limit where the task can run, if the preferred CPU is busy
+// running a higher priority task another CPU can still take it, but the task goes back to its preferred CPU afterwards.
+// Passing RTOS_CPUID_NO_CPU removes the hint, the task then simply stays with whichever CPU ran it last.
+// Once multitasking has started only a CPU that is up and running can be preferred.
+RTOS_RegInt RTOS_SetPreferredCpu(RTOS_Task *task, RTOS_CpuId cpu)
+{
+	RTOS_RegInt isRunning = RTOS.IsRunning;
+
+	RTOS_SavedCriticalState(saved_state = 0);
+
+	if (0 == task)
+	{
+		return RTOS_ERROR_FAILED;
+	}
+
+	if (((RTOS_CPUID_NO_CPU) != cpu)
+		&& ((cpu >= (RTOS_SMP_CPU_CORES)) || (isRunning && !RTOS_CpuMask_IsCpuIncluded(RTOS.Cpus, cpu))))
+	{
+		return RTOS_ERROR_FAILED;
+	}
+
+	if (isRunning)
+	{
+		RTOS_EnterCriticalSection(saved_state);
+	}
+
+	task->PreferredCpu = cpu;
+
+	if ((RTOS_CPUID_NO_CPU) != cpu)
+	{
+		rtos_MoveToRunQueue(task, cpu);
+	}
+
+	if (isRunning)
+	{
+		// The set of ready tasks has not changed, so nobody else is going to tell the new home CPU about a ready task.
+		rtos_SignalCpus(rtos_CpusToReschedule(RTOS_CurrentCpu()));
+		RTOS_ExitCriticalSection(saved_state);
+		RTOS_REQUEST_RESCHEDULING();
+	}
+
+	return RTOS_OK;
+}
+
+// Retrieve the soft affinity hint of a task, RTOS_CPUID_NO_CPU if it has none (or task is NULL).
+RTOS_CpuId RTOS_GetPreferredCpu(RTOS_Task *task)
+{
+	return (0 != task) ? task->PreferredCpu : RTOS_CPUID_NO_CPU;
+}
+
 // -----------------------------------------------------------------------------------
+// The current task of a CPU is only ever changed by that CPU itself, so there is no need for the OS lock,
+// interrupts are disabled only to make sure that the caller is not moved to another CPU while reading it.
 RTOS_Task *RTOS_GetCurrentTask(void)
 {
-	RTOS_Task *thisTask;
+	RTOS_Task *thisTask = 0;
 	RTOS_SavedCriticalState(saved_state);
 
-	RTOS_EnterCriticalSection(saved_state);
-	thisTask = RTOS_CURRENT_TASK();
-	RTOS_ExitCriticalSection(saved_state);
+	if (RTOS.IsRunning)
+	{
+		rtos_disableInterrupts(saved_state);
+		thisTask = RTOS_CURRENT_TASK();
+		rtos_restoreInterrupts(saved_state);
+	}
 
 	return thisTask;
 }
 
+// Per CPU run queues.
+// Every task belongs to the run queue of the CPU it was last dispatched on (task->HomeCpu, RTOS.CpuTasks[cpu]),
+// unless it has a soft affinity hint (see RTOS_SetPreferredCpu()), then it always stays in the queue of its preferred CPU.
+// The ready set of a CPU is its run queue intersected with RTOS.ReadyToRunTasks, which also serves as
+// the global summary of all the run queues, so making a task ready or not ready is still a single bit operation.
+// Tasks that have never run yet belong to no queue (RTOS.QueuedTasks is the union of all queues).
+// The run queues have no locks of their own, they are all protected by OSLock, just like the rest of the scheduler state.
+// What they do buy: a task keeps going back to the CPU whose cache it warmed up (or to its preferred CPU), a CPU only
+// takes a task queued elsewhere when the owner is not going to run it, and RTOS.RunningTasks is only written when it
+// changes. What they do not: every scheduling decision is still serialized on that one lock, so the scheduler itself
+// does not scale any better with the number of CPUs than it did with a single ready set. See the smp_scaling example
+// (targets/posix/README.md) for how much of the time goes to the lock.
+
+// Move a task to the run queue of a CPU.
+static void rtos_MoveToRunQueue(RTOS_Task *task, RTOS_CpuId cpu)
+{
+	RTOS_TaskPriority priority = task->Priority;
+	RTOS_CpuId home = task->HomeCpu;
+
+	if ((RTOS_CPUID_NO_CPU) != task->PreferredCpu)
+	{
+		cpu = task->PreferredCpu;
+	}
+
+	if (home == cpu)
+	{
+		return;
+	}
+
+	if ((RTOS_CPUID_NO_CPU) != home)
+	{
+		RTOS_TaskSet_RemoveMember(RTOS.CpuTasks[home], priority);
+	}
+	else
+	{
+		RTOS_TaskSet_AddMember(RTOS.QueuedTasks, priority);
+	}
+
+	RTOS_TaskSet_AddMember(RTOS.CpuTasks[cpu], priority);
+	task->HomeCpu = cpu;
+}
+
+// Take a task off all run queues, called when it is registered, a new task has no CPU affinity yet.
+// The task's priority is cleared on every CPU, there may be stale entries left behind by a previous task at the same priority.
+void rtos_RemoveFromRunQueues(RTOS_Task *task)
+{
+	RTOS_TaskPriority priority = task->Priority;
+	RTOS_CpuId i;
+
+	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
+	{
+		RTOS_TaskSet_RemoveMember(RTOS.CpuTasks[i], priority);
+	}
+
+	RTOS_TaskSet_RemoveMember(RTOS.QueuedTasks, priority);
+	task->HomeCpu = RTOS_CPUID_NO_CPU;
+}
+
+// Can a CPU take a ready task from the run queue of another CPU?
+// Only if the CPU owning the queue is not going to run it anyway, that is the task is not allowed there any more,
+// that CPU is busy running a higher priority task or it has no task at all (it is parked in the holding pen, or not
+// started yet, and may not run its scheduler any time soon). This way the highest priority tasks still end up running
+// on some CPU (the global priority guarantee) but a task is never pulled away from a cache that is about to run it.
+static RTOS_RegInt rtos_CanStealTask(RTOS_TaskPriority priority)
+{
+	RTOS_CpuId home = RTOS.TaskList[priority]->HomeCpu;
+	RTOS_Task *homeTask;
+
+	if (!RTOS_TaskSet_IsMember(RTOS.TasksAllowed[home], priority))
+	{
+		return 1;
+	}
+
+	homeTask = RTOS.PerCpu[home].CurrentTask;
+
+	return (0 == homeTask) || (homeTask->Priority > priority);
+}
+
+// Select a task to run on a CPU from a set of candidates (ready, allowed and not running elsewhere).
+// The highest priority task of the CPU's own queue (or one not queued anywhere) is preferred,
+// a higher priority task queued on another CPU is only taken if rtos_CanStealTask() says so.
+// An idle CPU steals the highest priority task it can.
+static RTOS_Task *rtos_SelectTask(RTOS_CpuId cpu, RTOS_TaskSet tasks)
+{
+	RTOS_TaskSet local;
+	RTOS_TaskSet remote;
+	RTOS_TaskPriority priority;
+	RTOS_TaskPriority localPriority;
+
+	local = RTOS_TaskSet_Intersection(tasks, RTOS_TaskSet_Union(RTOS.CpuTasks[cpu], ~RTOS.QueuedTasks));
+	remote = RTOS_TaskSet_Difference(tasks, local);
+
+	if (RTOS_TaskSet_IsEmpty(local))
+	{
+		localPriority = 0;	// Nothing in the local queue, any remote task would do.
+	}
+	else
+	{
+		localPriority = RTOS_GetHighestPriorityInSet(local);
+		remote = remote & ((~(RTOS_TaskSet)0) << localPriority);	// Only those above the best local task.
+	}
+
+	while (!RTOS_TaskSet_IsEmpty(remote))
+	{
+		priority = RTOS_GetHighestPriorityInSet(remote);
+
+		if (rtos_CanStealTask(priority))
+		{
+			return rtos_TaskFromPriority(priority);
+		}
+
+		RTOS_TaskSet_RemoveMember(remote, priority);
+	}
+
+	if (RTOS_TaskSet_IsEmpty(local))
+	{
+		if (RTOS_TaskSet_IsEmpty(tasks))
+		{
+			return 0;
+		}
+
+		// Everything remote is about to be run by its own CPU, anything left here is better than nothing.
+		priority = RTOS_GetHighestPriorityInSet(tasks);
+		return rtos_TaskFromPriority(priority);
+	}
+
+	return rtos_TaskFromPriority(localPriority);
+}
+
 // The Scheduler for SMP.
 // This scheduler is run on each CPU independently.
-// There is no attempt to assign tasks to CPUs in any centralized manner.
+// There is no attempt to assign tasks to CPUs in any centralized manner, each CPU serves its own run queue
+// and steals work from the others as described above.
 void rtos_Scheduler(void)
 {
 	RTOS_CpuId cpu;
 	RTOS_TaskPriority currentPriority;
 	RTOS_Task *currentTask;
-	RTOS_TaskPriority priority;
 	RTOS_TaskSet tasks;
 	RTOS_TaskSet runningTasks;
 	RTOS_Task *task;
 
 	cpu = RTOS_CurrentCpu();
-	currentTask = RTOS.CurrentTasks[cpu];
+	currentTask = RTOS.PerCpu[cpu].CurrentTask;
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(currentTask);
+#endif
 
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	rtos_ManageTimeshared(currentTask);
@@ -139,40 +331,46 @@ void rtos_Scheduler(void)
 		return;
 	}
 #endif
-	if (0 != currentTask)
-	{
-		currentPriority = currentTask->Priority;
-	}
-
 	tasks = RTOS_TaskSet_Intersection(RTOS.ReadyToRunTasks, RTOS.TasksAllowed[cpu]);
 	runningTasks = RTOS.RunningTasks;
 
 	if (0 != currentTask)
 	{
+		currentPriority = currentTask->Priority;
 		RTOS_TaskSet_RemoveMember(runningTasks, currentPriority);
 	}
 
 	tasks = RTOS_TaskSet_Difference(tasks, runningTasks);
 
-	priority = RTOS_GetHighestPriorityInSet(tasks);
+	task = rtos_SelectTask(cpu, tasks);
 
-	task = rtos_TaskFromPriority(priority);
-
-	if (0 != currentTask)
+	if ((0 != currentTask) && (currentTask != task))
 	{
 		currentTask->Cpu = RTOS_CPUID_NO_CPU;
 	}
 
 	if (0 == task)
 	{
+#if defined(RTOS_SUPPORT_TIMESHARE)
 		RTOS.TimeShareCpus = RTOS_CpuMask_RemoveCpu(RTOS.TimeShareCpus, cpu);
-		RTOS.CurrentTasks[cpu] = 0;
+#endif
+		RTOS.PerCpu[cpu].CurrentTask = 0;
 	}
 	else
 	{
-		RTOS_TaskSet_AddMember(runningTasks, priority);
-		RTOS.CurrentTasks[cpu] = task;
-		task->Cpu = cpu;
+		RTOS_TaskSet_AddMember(runningTasks, task->Priority);
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+		if (task->WakeupPending)
+		{
+			rtos_RecordWakeupLatency(task);
+		}
+#endif
+		if (task != currentTask)
+		{
+			RTOS.PerCpu[cpu].CurrentTask = task;
+			task->Cpu = cpu;
+			rtos_MoveToRunQueue(task, cpu);
+		}
 #if defined(RTOS_SUPPORT_TIMESHARE)
 		if (task->IsTimeshared)
 		{
@@ -184,9 +382,140 @@ void rtos_Scheduler(void)
 		}
 #endif
 	}
-	RTOS.RunningTasks = runningTasks;
 
+	// Shared state is only written when it actually changes, it avoids bouncing the cache line between the CPUs.
+	if (runningTasks != RTOS.RunningTasks)
+	{
+		RTOS.RunningTasks = runningTasks;
+	}
+
+#if defined(RTOS_INCLUDE_TRACE)
+	if (currentTask != RTOS.PerCpu[cpu].CurrentTask)
+	{
+		rtos_TraceContextSwitch(currentTask, RTOS.PerCpu[cpu].CurrentTask);
+	}
+#endif
+}
+
+// Find the CPUs that have to run their scheduler after the set of ready tasks has changed, called with the OS locked.
+// Every ready task that is not running is assigned to the CPU that is going to pick it up: its home CPU if that CPU
+// is allowed to run it and is running something less important, otherwise the allowed CPU running the lowest priority
+// task (or no task at all). This mirrors the stealing rules of rtos_SelectTask(). Tasks that cannot preempt anybody
+// do not cause an interrupt, so the typical wake-up signals a single CPU or none at all.
+static RTOS_CpuMask rtos_CpusToPreempt(void)
+{
+	RTOS_TaskSet tasks;
+	RTOS_TaskPriority priority;
+	RTOS_TaskPriority level[RTOS_SMP_CPU_CORES];	// Priority of the running task + 1, zero if there is no task.
+	RTOS_CpuMask claimed = 0;
+	RTOS_CpuId cpu;
+	RTOS_CpuId target;
+	RTOS_Task *task;
+
+	tasks = RTOS_TaskSet_Difference(RTOS.ReadyToRunTasks, RTOS.RunningTasks);
+
+	if (RTOS_TaskSet_IsEmpty(tasks))
+	{
+		return 0;
+	}
+
+	for (cpu = 0; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+	{
+		task = RTOS.PerCpu[cpu].CurrentTask;
+		level[cpu] = (0 == task) ? 0 : (task->Priority + 1);
+	}
+
+	while (!RTOS_TaskSet_IsEmpty(tasks))
+	{
+		priority = RTOS_GetHighestPriorityInSet(tasks);
+		RTOS_TaskSet_RemoveMember(tasks, priority);
+
+		target = RTOS.TaskList[priority]->HomeCpu;
+
+		if (((RTOS_CPUID_NO_CPU) == target)
+			|| RTOS_CpuMask_IsCpuIncluded(claimed, target)
+			|| !RTOS_TaskSet_IsMember(RTOS.TasksAllowed[target], priority)
+			|| (level[target] > priority))
+		{
+			target = RTOS_CPUID_NO_CPU;
+
+			for (cpu = 0; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+			{
+				if (RTOS_CpuMask_IsCpuIncluded(RTOS.Cpus, cpu)
+					&& !RTOS_CpuMask_IsCpuIncluded(claimed, cpu)
+					&& RTOS_TaskSet_IsMember(RTOS.TasksAllowed[cpu], priority)
+					&& (level[cpu] <= priority)
+					&& (((RTOS_CPUID_NO_CPU) == target) || (level[cpu] < level[target])))
+				{
+					target = cpu;
+				}
+			}
+		}
+
+		if ((RTOS_CPUID_NO_CPU) != target)
+		{
+			claimed = RTOS_CpuMask_AddCpu(claimed, target);
+		}
+	}
+
+	return claimed;
+}
+
+// Find the other CPUs that have to run their scheduler, after the scheduler has run on the calling CPU (which is never included).
+RTOS_CpuMask rtos_CpusToReschedule(RTOS_CpuId thisCpu)
+{
+	return RTOS_CpuMask_RemoveCpu(rtos_CpusToPreempt(), thisCpu);
+}
+
+// Used by RTOS_REQUEST_RESCHEDULING() in task context after the set of ready tasks has changed.
+// The scheduler has to be invoked only if the calling task cannot run anymore or some CPU (this one or another) has to be preempted.
+RTOS_RegInt rtos_IsPreemptionNeeded(void)
+{
+	RTOS_Task *thisTask;
+	RTOS_RegInt needed;
+	RTOS_SavedCriticalState(saved_state);
+
+	RTOS_EnterCriticalSection(saved_state);
+	thisTask = RTOS_CURRENT_TASK();
+	needed = (0 == thisTask)
+		|| !RTOS_TaskSet_IsMember(RTOS.ReadyToRunTasks, thisTask->Priority)
+		|| (0 != rtos_CpusToPreempt());
+	RTOS_ExitCriticalSection(saved_state);
+
+	return needed;
+}
+
+#if defined(RTOS_SUPPORT_TIMESHARE)
+// Called from the timer tick.
+// The time slices of time share tasks running on the other CPUs are charged here, so those CPUs do not have to be
+// interrupted on every tick, only when the slice of their task has run out.
+RTOS_CpuMask rtos_ExpiredTimeshareCpus(RTOS_CpuId thisCpu)
+{
+	RTOS_CpuMask cpus = 0;
+	RTOS_CpuId cpu;
+	RTOS_Task *task;
+
+	for (cpu = 0; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+	{
+		if ((cpu != thisCpu) && RTOS_CpuMask_IsCpuIncluded(RTOS.TimeShareCpus, cpu))
+		{
+			task = RTOS.PerCpu[cpu].CurrentTask;
+
+			if ((0 != task) && (task->IsTimeshared))
+			{
+				rtos_DeductTick(task);
+
+				if (0 == task->TicksToRun)
+				{
+					cpus = RTOS_CpuMask_AddCpu(cpus, cpu);
+				}
+			}
+		}
+	}
+
+	return cpus;
 }
+#endif
 
 #if defined(RTOS_INVOKE_YIELD)
 void rtos_SchedulerForYield(void)
@@ -199,7 +528,11 @@ void rtos_SchedulerForYield(void)
 	RTOS_Task *currentTask;
 	RTOS_TaskSet otherRunningTasks;
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
-	currentTask = RTOS.CurrentTasks[cpu];
+	currentTask = RTOS.PerCpu[cpu].CurrentTask;
+
+#if defined(RTOS_INCLUDE_RUNTIME_ACCOUNTING)
+	rtos_AccountRunTime(currentTask);
+#endif
 
 #if defined(RTOS_SUPPORT_TIMESHARE)
 	rtos_ManageTimeshared(currentTask);
@@ -236,12 +569,22 @@ void rtos_SchedulerForYield(void)
 
 	if (0 != task)
 	{
-		if (task != RTOS.CurrentTasks[cpu])
+		if (task != RTOS.PerCpu[cpu].CurrentTask)
 		{
+#if defined(RTOS_INCLUDE_TRACE)
+			rtos_TraceContextSwitch(currentTask, task);
+#endif
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+			if (task->WakeupPending)
+			{
+				rtos_RecordWakeupLatency(task);
+			}
+#endif
 			RTOS_TaskSet_RemoveMember(RTOS.RunningTasks, currentPriority);
-			RTOS.CurrentTasks[cpu]->Cpu = RTOS_CPUID_NO_CPU;
-			RTOS.CurrentTasks[cpu] = task;
+			RTOS.PerCpu[cpu].CurrentTask->Cpu = RTOS_CPUID_NO_CPU;
+			RTOS.PerCpu[cpu].CurrentTask = task;
 			task->Cpu = cpu;
+			rtos_MoveToRunQueue(task, cpu);
 			RTOS_TaskSet_AddMember(RTOS.RunningTasks, priority);
 #if defined(RTOS_SUPPORT_TIMESHARE)
 			if (task->IsTimeshared)
@@ -258,8 +601,8 @@ void rtos_SchedulerForYield(void)
 	else
 	{
 		RTOS_TaskSet_RemoveMember(RTOS.RunningTasks, currentPriority);
-		RTOS.CurrentTasks[cpu]->Cpu = RTOS_CPUID_NO_CPU;
-		RTOS.CurrentTasks[cpu] = task;	// In SMP configurations it is OK to have a task that is NULL.
+		RTOS.PerCpu[cpu].CurrentTask->Cpu = RTOS_CPUID_NO_CPU;
+		RTOS.PerCpu[cpu].CurrentTask = task;	// In SMP configurations it is OK to have a task that is NULL.
 	}
 }
 #endif /* RTOS_INVOKE_YIELD */
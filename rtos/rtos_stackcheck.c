@@ -0,0 +1,128 @@
+#include <rtos.h>
+#include <rtos_internals.h>
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+// Stack usage measurement by 'stack painting'.
+// The whole stack is filled with a known pattern when the task is created (see rtos_TargetInitializeTask()),
+// later the deepest point ever reached is found by looking for the first item that no longer holds the pattern.
+// All supported targets have stacks that grow downwards, so the scan starts at SP0 (the bottom of the stack)
+// and stops at the first overwritten item.
+
+// Called by the target port from rtos_TargetInitializeTask() before the initial stack frame is built.
+void rtos_PaintStack(RTOS_Task *task, unsigned long stackCapacity)
+{
+	RTOS_StackItem_t *p;
+	RTOS_StackItem_t *end;
+
+	task->StackCapacity = stackCapacity;
+
+	p = (RTOS_StackItem_t *)(task->SP0);
+
+	if (0 == p)
+	{
+		return;
+	}
+
+	end = p + stackCapacity;
+
+	while (p < end)
+	{
+		*p++ = (RTOS_STACK_PAINT_PATTERN);
+	}
+}
+
+// Returns the maximum number of stack items ever used by a task.
+// The stack is read without entering a critical section, so the result may be slightly behind if the task is running.
+unsigned long RTOS_GetStackHighWater(RTOS_Task *task)
+{
+	const RTOS_StackItem_t *p;
+	const RTOS_StackItem_t *end;
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == task)
+	{
+		return 0;
+	}
+#endif
+
+	p = (const RTOS_StackItem_t *)(task->SP0);
+
+	// Tasks initialized as the 'current thread of execution' have no stack managed by the OS.
+	if (0 == p)
+	{
+		return 0;
+	}
+
+	end = p + task->StackCapacity;
+
+	while ((p < end) && ((RTOS_STACK_PAINT_PATTERN) == *p))
+	{
+		p++;
+	}
+
+	return (unsigned long)(end - p);
+}
+
+#if defined(RTOS_INCLUDE_DELAY)
+// A low priority task to check the stacks of all tasks periodically.
+// If the number of unused stack items of a task falls below RTOS_STACK_CHECK_THRESHOLD, RTOS_STACK_CHECK_FAILED(task, free) is called.
+void RTOS_DefaultStackCheckFunction(void *p)
+{
+	RTOS_TaskPriority i;
+	RTOS_Task *task;
+	unsigned long used;
+	RTOS_SavedCriticalState(saved_state);
+
+	while(1)
+	{
+		for (i = 0; i <= RTOS_Priority_Highest; i++)
+		{
+			RTOS_EnterCriticalSection(saved_state);
+			task = RTOS.TaskList[i];
+			RTOS_ExitCriticalSection(saved_state);
+
+			if ((0 != task) && (0 != task->SP0))
+			{
+				used = RTOS_GetStackHighWater(task);
+
+				if ((task->StackCapacity - used) < (RTOS_STACK_CHECK_THRESHOLD))
+				{
+					RTOS_STACK_CHECK_FAILED(task, task->StackCapacity - used);
+				}
+			}
+		}
+
+		RTOS_Delay(RTOS_STACK_CHECK_PERIOD);
+	}
+	(void)p;
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#include <rtos.h>
+#include <rtos_internals.h>
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#if defined(RTOS_INCLUDE_TRACE)
+// Kernel event trace.
+// Every CPU has its own ring buffer, and a buffer is only ever written by its own CPU with interrupts disabled,
+// so recording an event needs no locking at all, not even on SMP systems.
+// The buffers are statically initialized so that a memory dump is always decodable, even if taken before the OS has started.
+// When a buffer is full the oldest events are overwritten.
+
+// Other CPUs may read the header (see miscellaneous/trace/rtos_trace_export.c), on a single CPU only the order of the
+// stores matters, which the volatile fields already guarantee.
+#if defined(RTOS_SMP)
+#define RTOS_TRACE_BARRIER() __sync_synchronize()
+#else
+#define RTOS_TRACE_BARRIER() (void)0
+#endif
+
+RTOS_TraceBuffer RTOS_TraceBuffers[RTOS_TRACE_CPUS] =
+{
+	[0 ... (RTOS_TRACE_CPUS) - 1] = { { RTOS_TRACE_MAGIC, RTOS_TRACE_FORMAT_VERSION, RTOS_TRACE_BUFFER_SIZE, 0, 0 } }
+};
+
+RTOS_INLINE void rtos_TraceWrite(RTOS_TraceBuffer *buffer, uint32_t info, uint32_t data)
+{
+	uint32_t head;
+	volatile RTOS_TraceRecord *record;
+
+	head = buffer->Header.Head;
+	record = &(buffer->Events[head & ((RTOS_TRACE_BUFFER_SIZE) - 1)]);
+
+	record->Timestamp = (uint32_t)RTOS_READ_CYCLE_COUNTER();
+	record->Info = info;
+	record->Data = data;
+
+	// Only advance the head once the record is complete, so a debugger stopping the CPU never sees a half written record.
+	buffer->Header.Head = head + 1;
+
+	// When Head has just wrapped around publish the new Wraps only after it, so that nobody ever sees the new Wraps
+	// together with the old Head (which would overstate the number of lost events by 2^32).
+	if (0 == (uint32_t)(head + 1))
+	{
+		RTOS_TRACE_BARRIER();
+		buffer->Header.Wraps++;
+	}
+}
+
+RTOS_INLINE uint32_t rtos_TracePriority(RTOS_Task *task)
+{
+	return (0 == task) ? RTOS_TRACE_NO_TASK : (uint32_t)(task->Priority);
+}
+
+void RTOS_TraceEvent(uint32_t type, uint32_t extra, uint32_t data)
+{
+#if defined(RTOS_SMP)
+	RTOS_CpuId cpu = RTOS_CurrentCpu();
+
+	rtos_TraceWrite(&(RTOS_TraceBuffers[cpu]), RTOS_TRACE_INFO(type, rtos_TracePriority(RTOS.PerCpu[cpu].CurrentTask), extra), data);
+#else
+	rtos_TraceWrite(&(RTOS_TraceBuffers[0]), RTOS_TRACE_INFO(type, rtos_TracePriority(RTOS.CurrentTask), extra), data);
+#endif
+}
+
+void rtos_TraceContextSwitch(RTOS_Task *previous, RTOS_Task *next)
+{
+	uint32_t info;
+	uint32_t status;
+
+	info = RTOS_TRACE_INFO(RTOS_TRACE_EVENT_CONTEXT_SWITCH, rtos_TracePriority(next), rtos_TracePriority(previous));
+	status = (0 == previous) ? 0 : (uint32_t)(previous->Status);
+
+#if defined(RTOS_SMP)
+	rtos_TraceWrite(&(RTOS_TraceBuffers[RTOS_CurrentCpu()]), info, status);
+#else
+	rtos_TraceWrite(&(RTOS_TraceBuffers[0]), info, status);
+#endif
+}
+
+#endif
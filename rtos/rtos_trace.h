@@ -0,0 +1,96 @@
+#ifndef RTOS_TRACE_H
+#define RTOS_TRACE_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Binary format of the kernel event trace.
+// This header is shared by the OS (rtos_trace.c) and the host side tools (miscellaneous/trace),
+// so it must not depend on anything but <stdint.h>.
+//
+// There is one trace buffer per CPU. A buffer is a header followed by a ring of fixed size records.
+// All fields are 32 bit words in the byte order of the target, a host tool can tell the byte order from Magic.
+// Head counts all the events ever recorded modulo 2^32, the most recent event is in Events[(Head - 1) % Size].
+// Wraps counts how many times Head has wrapped around, the oldest event still in the buffer is always number Head - Size
+// (modulo 2^32) unless fewer than Size events were ever recorded (Wraps == 0 and Head < Size).
+// In total (Wraps * 2^32 + Head - Size) events have been overwritten once the buffer is full.
+// Wraps is incremented right after Head wraps around, a dump taken between the two stores understates the lost events by 2^32.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTOS_TRACE_MAGIC		0x4A545243	/* 'JTRC' */
+#define RTOS_TRACE_FORMAT_VERSION	2
+
+// Event types.
+#define RTOS_TRACE_EVENT_CONTEXT_SWITCH		0x01	/* Extra: priority of the previous task, Data: status of the previous task. */
+#define RTOS_TRACE_EVENT_ISR_ENTER		0x02	/* Extra: interrupt vector or exception number if known, otherwise 0. */
+#define RTOS_TRACE_EVENT_ISR_EXIT		0x03	/* Extra: interrupt vector or exception number if known, otherwise 0. */
+#define RTOS_TRACE_EVENT_SEMAPHORE_POST		0x04	/* Extra: count after the operation, Data: semaphore. */
+#define RTOS_TRACE_EVENT_SEMAPHORE_GET		0x05	/* Extra: result (RTOS_OK, RTOS_TIMED_OUT, ...), Data: semaphore. */
+#define RTOS_TRACE_EVENT_TASK_BLOCK		0x06	/* Extra: priority of the blocked task, Data: event waited for. */
+#define RTOS_TRACE_EVENT_TASK_UNBLOCK		0x07	/* Extra: priority of the unblocked task, Data: event or 0. */
+#define RTOS_TRACE_EVENT_DELAY			0x08	/* Data: time (in ticks) to wake up. */
+#define RTOS_TRACE_EVENT_TIMEOUT		0x09	/* Extra: priority of the task, Data: event waited for or 0 if the task was sleeping. */
+#define RTOS_TRACE_EVENT_QUEUE_ENQUEUE		0x0A	/* Extra: index of the slot used, Data: queue. */
+#define RTOS_TRACE_EVENT_QUEUE_PREPEND		0x0B	/* Extra: index of the slot used, Data: queue. */
+#define RTOS_TRACE_EVENT_QUEUE_DEQUEUE		0x0C	/* Extra: index of the slot used, Data: queue. */
+#define RTOS_TRACE_EVENT_QUEUE_PEEK		0x0D	/* Extra: index of the slot used, Data: queue. */
+
+#define RTOS_TRACE_EVENT_USER			0x80	/* Types from here up to 0xFF are free for the application. */
+
+// Value in the task fields if there was no task (e.g. a CPU in the holding pen).
+#define RTOS_TRACE_NO_TASK			0xFF
+
+// Info = Type << 24 | Task << 16 | Extra, where Task is the priority of the task running on the CPU when the event was recorded
+// (for a context switch the task switched to).
+#define RTOS_TRACE_INFO(TYPE, TASK, EXTRA)	((((uint32_t)(TYPE) & 0xFF) << 24) | (((uint32_t)(TASK) & 0xFF) << 16) | ((uint32_t)(EXTRA) & 0xFFFF))
+#define RTOS_TRACE_INFO_TYPE(INFO)		(((INFO) >> 24) & 0xFF)
+#define RTOS_TRACE_INFO_TASK(INFO)		(((INFO) >> 16) & 0xFF)
+#define RTOS_TRACE_INFO_EXTRA(INFO)		((INFO) & 0xFFFF)
+
+struct rtos_TraceRecord
+{
+	uint32_t	Timestamp;	// Low 32 bits of the cycle counter (see RTOS_READ_CYCLE_COUNTER()).
+	uint32_t	Info;		// See RTOS_TRACE_INFO().
+	uint32_t	Data;		// Event specific, usually the address of the object involved.
+};
+typedef struct rtos_TraceRecord RTOS_TraceRecord;
+
+struct rtos_TraceHeader
+{
+	uint32_t	Magic;		// RTOS_TRACE_MAGIC.
+	uint32_t	Version;	// RTOS_TRACE_FORMAT_VERSION.
+	uint32_t	Size;		// Number of records in the buffer, a power of 2.
+	uint32_t	Head;		// Number of events recorded so far (wraps around at 2^32).
+	uint32_t	Wraps;		// Number of times Head has wrapped around.
+};
+typedef struct rtos_TraceHeader RTOS_TraceHeader;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -104,11 +104,17 @@ void SysTick_Handler(void)
 {
 	RTOS_SavedCriticalState(saved_state);
 
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
+
 	// Currently rtos_TimerTick() assumes that it will not be interrupted.
 	// So run it with interrupts disabled.
 	// To kep it short, use a timer task.
 	RTOS_EnterCriticalSection(saved_state);
+		RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 15, 0);	// SysTick is exception 15.
 		rtos_TimerTick();
+		RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 15, 0);
 	RTOS_ExitCriticalSection(saved_state);
 	__asm__ __volatile__ ("isb");
 
@@ -124,6 +124,10 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 
 	RTOS_ASSERT(0 != task->SP0); // Start up code does not support initializing a s'current thread', so do not allow it.
 
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+	rtos_PaintStack(task, stackCapacity);
+#endif
+
 	task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 	sp = (rtos_StackFrame *)(task->SP);
 	sp->hwsaved.r0 = 0;
@@ -180,11 +184,17 @@ void SysTick_Handler(void)
 {
 	RTOS_SavedCriticalState(saved_state);
 
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
+
 	// Currently rtos_TimerTick() assumes that it will not be interrupted.
 	// So run it with interrupts disabled.
 	// To kep it short, use a timer task.
 	RTOS_EnterCriticalSection(saved_state);
+		RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 15, 0);	// SysTick is exception 15.
 		rtos_TimerTick();
+		RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 15, 0);
 	RTOS_ExitCriticalSection(saved_state);
 
 	RTOS_SIGNAL_SCHEDULER_FROM_INTERRUPT();
@@ -238,5 +248,12 @@ int rtos_CpuInit(void)
 
 	sysTick_init();
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	// Start the DWT cycle counter.
+	ARM_M3_SET_REG(ARM_M3_REG_DEMCR, (*(uint32_t *)(ARM_M3_REG_DEMCR)) | ARM_M3_REG_DEMCR_bit_TRCENA);
+	ARM_M3_SET_REG(ARM_M3_REG_DWT_CYCCNT, 0);
+	ARM_M3_SET_REG(ARM_M3_REG_DWT_CTRL, (*(uint32_t *)(ARM_M3_REG_DWT_CTRL)) | ARM_M3_REG_DWT_CTRL_bit_CYCCNTENA);
+#endif
+
 	return 0;
 }
@@ -86,6 +86,13 @@
 
 #define ARM_M3_REG_IPR0 0xE000E400	// Interrupt priority register 0.
 
+// Debug and trace (the cycle counter is not implemented on the Cortex-M0/M0+).
+#define ARM_M3_REG_DEMCR 0xE000EDFC	// Debug Exception and Monitor Control Register.
+#define ARM_M3_REG_DEMCR_bit_TRCENA	0x01000000
+#define ARM_M3_REG_DWT_CTRL 0xE0001000	// DWT Control Register.
+#define ARM_M3_REG_DWT_CTRL_bit_CYCCNTENA	0x00000001
+#define ARM_M3_REG_DWT_CYCCNT 0xE0001004	// DWT Cycle Count Register.
+
 #define ARM_M3_SET_REG(REG, VALUE) *((volatile uint32_t *)(REG)) = (VALUE)
 
 #define ARM_M3_PSR_ISR_NUMBER_mask 0x01FF
@@ -71,8 +71,9 @@
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
 
-#define RTOS_EnterCriticalSection(X)	rtos_disableInterrupts(X, RTOS_INTERRUPTS_DISABLED_PRIORITY_bits)
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X, RTOS_INTERRUPTS_DISABLED_PRIORITY_bits)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 == (X))	/* BASEPRI was not masking anything. */
 
 #define RTOS_EnableInterrupts() rtos_restoreInterrupts(0)
 #define RTOS_DisableInterrupts() do { RTOS_Critical_State rtos_tmp_saved; rtos_disableInterrupts(rtos_tmp_saved,  RTOS_INTERRUPTS_DISABLED_PRIORITY_bits); } while(0)
@@ -86,6 +87,8 @@
 #define RTOS_INVOKE_YIELD() __asm__ __volatile__ ("SVC #1")
 #define RTOS_SIGNAL_SCHEDULER_FROM_INTERRUPT() do { *((uint32_t *)(ARM_M3_REG_ICSR)) = (ARM_M3_REG_ICSR_bit_PENDV); } while(0)
 
+#define RTOS_READ_CYCLE_COUNTER() (*((volatile uint32_t *)(ARM_M3_REG_DWT_CYCCNT)))
+
 #if defined(RTOS_TARGET_HAS_FPU)
 
 #define RTOS_TASK_EXEC_LOCATION(TASK) \
@@ -100,9 +100,17 @@ void rtos_Invoke_Scheduler(void)
 
 void rtos_Isr(void)
 {
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
 	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
 	board_IRQHandler();
-	rtos_Scheduler();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
 	RTOS.InterruptNesting--;
 }
 
@@ -126,6 +134,20 @@ void RTOS_DefaultIdleFunction(void *p)
 	(void)p;
 }
 // ------------------------------------------------------ Some initialization stuff. ---------------------------------------------
+#if defined(RTOS_USE_CYCLE_COUNTER)
+// Enable the PMU cycle counter of the calling CPU, it counts every cycle starting from zero.
+static void rtos_StartCycleCounter(void)
+{
+	uint32_t pmcr;
+
+	__asm__ __volatile__ ("MRC p15, 0, %0, c9, c12, 0" : "=r" (pmcr));		// PMCR
+	pmcr = (pmcr | 0x05) & ~0x08;							// E = 1, C = 1 (reset counter), D = 0 (no divider).
+	__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+	__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 1" : : "r" (0x80000000));	// PMCNTENSET: enable the cycle counter.
+	__asm__ __volatile__ ("ISB");
+}
+#endif
+
 void rtos_TaskEntryPoint(void)
 {
 	rtos_RunTask();
@@ -139,6 +161,9 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
 	if (0 != task->SP0)
 	{
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
 		task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 		sp = (rtos_StackFrame *)(task->SP);
 		sp->spsr = 0x1F;
@@ -165,6 +190,10 @@ int RTOS_StartMultitasking(void)
 {
 	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	rtos_StartCycleCounter();
+#endif
+
 	RTOS_CURRENT_TASK() =  RTOS.TaskList[RTOS_Priority_Idle];	// Default to the Idle task.
 
 	// BTW: There is no need to enable interrupts here,
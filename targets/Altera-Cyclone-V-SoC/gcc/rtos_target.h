@@ -53,8 +53,9 @@
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
 
-#define RTOS_EnterCriticalSection(X)	rtos_disableInterrupts(X)
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 == ((X) & 0x80))	/* CPSR I bit. */
 
 #define RTOS_EnableInterrupts() rtos_enableInterrupts()
 #define RTOS_DisableInterrupts() do { RTOS_Critical_State rtos_tmp_saved; rtos_disableInterrupts(rtos_tmp_saved); } while(0)
@@ -63,6 +64,9 @@
 
 #define rtos_CLZ(X) __builtin_clzl(X)
 
+// The PMU cycle counter (PMCCNTR), started by rtos_StartCycleCounter().
+#define RTOS_READ_CYCLE_COUNTER() ({ uint32_t rtos_ccnt; __asm__ __volatile__ ("MRC p15, 0, %0, c9, c13, 0" : "=r" (rtos_ccnt)); rtos_ccnt; })
+
 #define RTOS_INVOKE_SCHEDULER() __asm volatile ( "SWI 0" ) 
 #define RTOS_INVOKE_YIELD() __asm volatile ( "SWI 1" ) 
 
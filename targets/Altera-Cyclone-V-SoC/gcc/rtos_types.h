@@ -56,6 +56,8 @@ typedef struct rtos_StackFrame rtos_StackFrame;
 
 #define RTOS_MIN_STACK_SIZE 512 /* What is the real number? */
 
+#define RTOS_CACHE_LINE_SIZE 32		/* Cortex-A9 L1 data cache line. */
+
 #if defined(RTOS_SMP)
 typedef uint32_t RTOS_CpuId;
 #define RTOS_CPUID_NO_CPU ((RTOS_CpuId)(-1))
@@ -62,9 +62,22 @@ int board_TimerInit(void)
 	XTmrCtr_SetOptions(&TimerInstance, 0, XTC_DOWN_COUNT_OPTION | XTC_INT_MODE_OPTION | XTC_AUTO_RELOAD_OPTION );
 	XTmrCtr_SetResetValue(&TimerInstance, 0, ((XPAR_CPU_CORE_CLOCK_FREQ_HZ) / (RTOS_TICKS_PER_SECOND)));
 	XTmrCtr_Start(&TimerInstance, 0 );
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	// The second counter of the timer is free running, used as the cycle counter (run time accounting, tracing).
+	XTmrCtr_SetOptions(&TimerInstance, 1, XTC_AUTO_RELOAD_OPTION);
+	XTmrCtr_SetResetValue(&TimerInstance, 1, 0);
+	XTmrCtr_Start(&TimerInstance, 1);
+#endif
 	return 0;
 }
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+uint32_t board_ReadCycleCounter(void)
+{
+	return XTmrCtr_GetTimerCounterReg(TimerInstance.BaseAddress, 1);
+}
+#endif
+
 int board_InterruptInit(void)
 {
     XStatus  status = XIntc_Initialize(&InterruptController, INTC_DEVICE_ID);
@@ -47,8 +47,13 @@ void rtos_InvokeYield(void)
 
 void rtos_Isr_Handler(void)
 {
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
 	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
 	board_HandleIRQ();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
 	rtos_Scheduler();
 	RTOS.InterruptNesting--;
 }
@@ -75,6 +80,9 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 
 	if (0 != task->SP0)	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
 	{
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
 		task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 		sp = (rtos_StackFrame *)(task->SP);
 
@@ -43,8 +43,9 @@
 #define rtos_restoreInterrupts(SAVED)	__asm__ volatile ("mts rmsr, %0\n" : : "r" (SAVED) : "cc")
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
-#define RTOS_EnterCriticalSection(X)	(X) = rtos_disableInterrupts()
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	(X) = rtos_disableInterrupts()
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 != ((X) & 2))	/* MSR[IE]. */
 
 
 #define RTOS_EnableInterrupts() rtos_enableInterrupts()
@@ -57,6 +58,10 @@ extern void rtos_InvokeYield(void);
 #define RTOS_INVOKE_SCHEDULER() rtos_InvokeScheduler()
 #define RTOS_INVOKE_YIELD() rtos_InvokeYield()
 
+// Free running counter of the AXI timer (counts at the timer's clock, see board.c).
+extern uint32_t board_ReadCycleCounter(void);
+#define RTOS_READ_CYCLE_COUNTER() board_ReadCycleCounter()
+
 #define RTOS_TASK_EXEC_LOCATION(TASK) ((rtos_StackFrame *)((TASK)->SP))->regs[14]
 
 // Utility functions.
@@ -58,6 +58,25 @@ uint32_t rtos_arm_CLZ(uint32_t x)
 
 #endif
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+// The ARM1176 cycle counter (CCNT), accessed through CP15 which is not available in Thumb state.
+uint32_t rtos_arm_ReadCycleCounter(void)
+{
+	uint32_t ccnt;
+	__asm__ __volatile__ ("MRC p15, 0, %0, c15, c12, 1" : "=r" (ccnt));
+	return ccnt;
+}
+
+static void rtos_StartCycleCounter(void)
+{
+	uint32_t pmnc;
+
+	__asm__ __volatile__ ("MRC p15, 0, %0, c15, c12, 0" : "=r" (pmnc));	// PMNC
+	pmnc = (pmnc | 0x05) & ~0x08;						// E = 1, C = 1 (reset CCNT), D = 0 (no divider).
+	__asm__ __volatile__ ("MCR p15, 0, %0, c15, c12, 0" : : "r" (pmnc));
+}
+#endif
+
 #define RTOS_RESTORE_CONTEXT()	\
 { \
 	__asm__ volatile ("LDR		R0, =RTOS");		/* The address of the RTOS structure.*/ 	\
@@ -135,12 +154,20 @@ void rtos_Invoke_Scheduler(void)
 
 void rtos_HandleIsr(void)
 {
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
 	RTOS.InterruptNesting++;
 #if defined(RTOS_COUNT_CRITICAL_NESTING)
 	RTOS_CURRENT_TASK()->criticalNesting++;
 #endif
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
 	board_HandleIRQ();
-	rtos_Scheduler();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
 	RTOS.InterruptNesting--;
 #if defined(RTOS_COUNT_CRITICAL_NESTING)
 	RTOS_CURRENT_TASK()->criticalNesting--;
@@ -174,6 +201,9 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
 	if (0 != task->SP0)
 	{
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
 		task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 		sp = (rtos_StackFrame *)(task->SP);
 		sp->spsr = 0x1F;
@@ -200,6 +230,10 @@ int RTOS_StartMultitasking(void)
 {
 	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	rtos_StartCycleCounter();
+#endif
+
 	RTOS.CurrentTask =  RTOS.TaskList[RTOS_Priority_Idle];	// Default to the Idle task.
 	rtos_Scheduler();					// Let the scheduler pick a higher priority task.
 	// BTW: There is no need to enable interrupts here, 
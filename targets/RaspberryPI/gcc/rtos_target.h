@@ -49,20 +49,21 @@
 
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 == ((X) & 0x80))	/* CPSR I bit. */
 
 #if defined(__thumb__)
 extern RTOS_Critical_State rtos_arm_disableInterrupts(void);
 extern void rtos_arm_enableInterrupts(void);
 extern void rtos_arm_restoreInterrupts(RTOS_Critical_State saved_state);
 extern uint32_t rtos_arm_CLZ(uint32_t x);
-#define RTOS_EnterCriticalSection(X)	(X) = rtos_arm_disableInterrupts()
-#define RTOS_ExitCriticalSection(X)	rtos_arm_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	(X) = rtos_arm_disableInterrupts()
+#define rtos_TargetExitCriticalSection(X)	rtos_arm_restoreInterrupts(X)
 #define RTOS_DisableInterrupts()	(void)rtos_arm_disableInterrupts()
 #define RTOS_EnableInterrupts()		rtos_arm_enableInterrupts()
 #define rtos_CLZ(X)			rtos_arm_CLZ(X)
 #else
-#define RTOS_EnterCriticalSection(X)	rtos_disableInterrupts(X)
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
 #define RTOS_EnableInterrupts()		rtos_enableInterrupts()
 #define RTOS_DisableInterrupts()	do { RTOS_Critical_State rtos_tmp_saved; rtos_disableInterrupts(rtos_tmp_saved); } while(0)
 #define rtos_CLZ(X)			__builtin_clzl(X)
@@ -74,6 +75,9 @@ extern uint32_t rtos_arm_CLZ(uint32_t x);
 
 #define RTOS_INLINE static inline
 
+extern uint32_t rtos_arm_ReadCycleCounter(void);
+#define RTOS_READ_CYCLE_COUNTER() rtos_arm_ReadCycleCounter()
+
 #define RTOS_INVOKE_SCHEDULER() __asm volatile ( "SWI 0" ) 
 #define RTOS_INVOKE_YIELD() __asm volatile ( "SWI 1" ) 
 
@@ -54,5 +54,7 @@ typedef struct rtos_StackFrame rtos_StackFrame;
 
 #define RTOS_MIN_STACK_SIZE 512 /* What is the real number? */
 
+#define RTOS_CACHE_LINE_SIZE 32		/* ARM1176 L1 data cache line. */
+
 #endif
 
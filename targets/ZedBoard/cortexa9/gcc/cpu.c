@@ -27,7 +27,17 @@
 #include <xil_cache.h>
 #include <xil_cache.h>
 
-#if (RTOS_ARM_NEON_SUPPORT)
+#if (RTOS_ARM_LAZY_NEON)
+// The NEON registers are switched by rtos_Undefined_Handler() when they are actually used.
+// Only the unit is enabled or disabled here depending on whether the task being switched in (R0) owns the register contents.
+#define SAVE_NEON_REGISTERS()
+#define RESTORE_NEON_REGISTERS()	__asm__ volatile ("LDR   R1, =rtos_arm_NeonOwner");	\
+					__asm__ volatile ("LDR   R1, [R1]");			\
+					__asm__ volatile ("CMP   R0, R1");			\
+					__asm__ volatile ("MOVEQ R1, #0x40000000");		\
+					__asm__ volatile ("MOVNE R1, #0");			\
+					__asm__ volatile ("VMSR  FPEXC, R1");
+#elif (RTOS_ARM_NEON_SUPPORT)
 #define SAVE_NEON_REGISTERS()		__asm__ volatile ("VSTMDB LR!, {D16-D31}");	\
 					__asm__ volatile ("VSTMDB LR!, {D0-D15}");	\
 					__asm__ volatile ("VMRS  R0,   FPSCR");		\
@@ -48,6 +58,45 @@
 
 extern void rtos_Debug(void);
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+// Enable the PMU cycle counter of the calling CPU, it counts every cycle starting from zero.
+static void rtos_StartCycleCounter(void)
+{
+	uint32_t pmcr;
+
+	__asm__ __volatile__ ("MRC p15, 0, %0, c9, c12, 0" : "=r" (pmcr));		// PMCR
+	pmcr = (pmcr | 0x05) & ~0x08;							// E = 1, C = 1 (reset counter), D = 0 (no divider).
+	__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+	__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 1" : : "r" (0x80000000));	// PMCNTENSET: enable the cycle counter.
+	__asm__ __volatile__ ("ISB");
+}
+#endif
+
+// PMU event counter 0 counts L1 data cache refills (event 0x03), it is set up by the first call on each CPU.
+uint32_t rtos_arm_ReadCacheMisses(void)
+{
+	uint32_t type;
+	uint32_t pmcr;
+	uint32_t count;
+
+	__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 5" : : "r" (0));		// PMSELR: select event counter 0.
+	__asm__ __volatile__ ("ISB");
+	__asm__ __volatile__ ("MRC p15, 0, %0, c9, c13, 1" : "=r" (type));		// PMXEVTYPER
+
+	if (0x03 != (0xFF & type))
+	{
+		__asm__ __volatile__ ("MCR p15, 0, %0, c9, c13, 1" : : "r" (0x03));	// PMXEVTYPER: L1 data cache refill.
+		__asm__ __volatile__ ("MRC p15, 0, %0, c9, c12, 0" : "=r" (pmcr));	// PMCR
+		__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 0" : : "r" (pmcr | 0x01));	// E = 1, nothing is reset.
+		__asm__ __volatile__ ("MCR p15, 0, %0, c9, c12, 1" : : "r" (0x00000001));	// PMCNTENSET: enable event counter 0.
+		__asm__ __volatile__ ("ISB");
+	}
+
+	__asm__ __volatile__ ("MRC p15, 0, %0, c9, c13, 2" : "=r" (count));		// PMXEVCNTR
+
+	return count;
+}
+
 #if defined(RTOS_SMP)
 #if (RTOS_SMP_CPU_CORES) > 2
 #error This target only has two CPUs. RTOS_SMP_CPU_CORES must be <= 2.
@@ -88,24 +137,57 @@ RTOS_INLINE uint32_t rtos_arm_ReadPeripheralReg(uint32_t reg)
 	return value;
 }
 
+// Per CPU 'work available' mailboxes for CPUs waiting in the holding pen.
+// A CPU clears its own flag (holding the OS lock) before it parks, whoever signals it sets the flag before sending the SGI,
+// so a parked CPU only goes back for the OS lock when it has actually been asked to run the scheduler.
+// Each mailbox has a cache line of its own, posting work to one CPU must not disturb the others spinning on theirs.
+struct rtos_CpuMailbox
+{
+	volatile uint32_t WorkAvailable;
+} RTOS_CACHE_ALIGNED;
+
+static struct rtos_CpuMailbox rtos_CpuWorkAvailable[RTOS_SMP_CPU_CORES];
+
+static void rtos_PostCpuWork(RTOS_CpuMask cpus)
+{
+	RTOS_CpuId i;
+
+	for (i = 0; i < (RTOS_SMP_CPU_CORES); i++)
+	{
+		if (RTOS_CpuMask_IsCpuIncluded(cpus, i))
+		{
+			rtos_CpuWorkAvailable[i].WorkAvailable = 1;
+		}
+	}
+
+	__asm__ __volatile__ ("DSB");		// The flags must be visible before the SGI arrives.
+	__asm__ __volatile__ ("SEV");		// CPU 0 waits in WFE (see rtos_CpuHoldingPenLoop()).
+}
+
 void rtos_SignalAllCpus(RTOS_CpuMask cpus)
 {
 	uint32_t icdsgir;
 
 	if (0 != cpus)
 	{
+		rtos_PostCpuWork(cpus);
 		icdsgir = 0x00000001 | (((uint32_t) (0xFF & cpus)) << 16); // All CPUs specified.
 		rtos_arm_WritePeripheralReg(ARM_REG_ICDSGIR, icdsgir);
 	}
 }
 
+// Signal the specified CPUs, but never the requester.
+// The SGI goes to the target list only, the 'all but the requester' filter would ignore the list and interrupt every other CPU.
 void rtos_SignalCpus(RTOS_CpuMask cpus)
 {
 	uint32_t icdsgir;
 
+	cpus = RTOS_CpuMask_RemoveCpu(cpus, RTOS_CurrentCpu());
+
 	if (0 != cpus)
 	{
-		icdsgir = 0x01000001 | (((uint32_t) (0xFF & cpus)) << 16); // All but the requester.
+		rtos_PostCpuWork(cpus);
+		icdsgir = 0x00000001 | (((uint32_t) (0xFF & cpus)) << 16); // Only the CPUs specified.
 		rtos_arm_WritePeripheralReg(ARM_REG_ICDSGIR, icdsgir);
 	}
 }
@@ -140,24 +222,52 @@ inline uint32_t rtos_STREX(volatile uint32_t *address, uint32_t value)
 })
 #endif
 
-#define LOCK_ID_MARKER 0x00008000
+// RTOS_CpuMutex is a ticket lock, CPUs get the lock in the order they asked for it, so no CPU can be starved
+// and while waiting they only read the lock (mostly sleeping in WFE), the line is only written by taking a ticket and unlocking.
+// Bits 31..24: the next ticket to hand out, bits 23..16: the ticket being served, bits 15..0: the owner (LOCK_ID_MARKER | cpu).
+// An all zero value is an unlocked mutex nobody is waiting for.
+#define LOCK_ID_MARKER		0x00008000
+#define LOCK_OWNER_MASK		0x0000FFFF
+#define LOCK_NEXT_TICKET	0x01000000
+#define LOCK_SERVING_ONE	0x00010000
+#define LOCK_SERVING_MASK	0x00FF0000
+#define LOCK_TICKET(X)		(((X) >> 24) & 0xFF)
+#define LOCK_SERVING(X)		(((X) >> 16) & 0xFF)
 
 // Lock a mutex that prevents other CPUs from accessing a resource.
+// Must be called with interrupts disabled, once a ticket is taken the CPU cannot do anything else until it is served.
 RTOS_RegInt volatile rtos_LockCpuMutex(volatile RTOS_CpuMutex *lock)
 {
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
 	uint32_t id = (LOCK_ID_MARKER) | cpu;
+	uint32_t value;
+	uint32_t failed;
+	uint32_t ticket;
 
-	__asm__ __volatile__(
-	"1:"
-			"LDREX r2, [%0]\n"
-			"CMP r2, #0\n"
-			"STREXEQ r2, %1, [%0]\n"
-			"CMPEQ r2, #0\n"
-			"WFENE\n"
-			"BNE 1b\n"
-			"DMB \n"
-			: : "r" (lock), "r" (id) : "r2", "cc");
+	// Take a ticket.
+	do
+	{
+		__asm__ __volatile__("LDREX %0, [%1]" : "=&r" (value) : "r" (lock) : "memory");
+		__asm__ __volatile__("STREX %0, %2, [%1]" : "=&r" (failed) : "r" (lock), "r" (value + (LOCK_NEXT_TICKET)) : "memory");
+	} while (0 != failed);
+
+	ticket = LOCK_TICKET(value);
+
+	// Wait for our turn. The unlocking CPU executes SEV after the store, if it happens between reading the lock
+	// and WFE the event register is already set and WFE returns at once.
+	while (LOCK_SERVING(*lock) != ticket)
+	{
+		__asm__ __volatile__("WFE");
+	}
+
+	// Record the owner, other CPUs may be taking tickets at the same time.
+	do
+	{
+		__asm__ __volatile__("LDREX %0, [%1]" : "=&r" (value) : "r" (lock) : "memory");
+		__asm__ __volatile__("STREX %0, %2, [%1]" : "=&r" (failed) : "r" (lock), "r" (value | id) : "memory");
+	} while (0 != failed);
+
+	__asm__ __volatile__ ("DMB" : : : "memory");
 
 	return 0;
 }
@@ -167,19 +277,26 @@ RTOS_RegInt volatile rtos_UnlockCpuMutex(volatile RTOS_CpuMutex *lock)
 {
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
 	uint32_t id = (LOCK_ID_MARKER) | cpu;
+	uint32_t value;
+	uint32_t failed;
 
 	// xil_printf("UnlockMutex: lock=0x%x cpu=%d task=%d\r\n",*lock, cpu, RTOS_CURRENT_TASK()->Priority);
-	if (*lock != id)
+	if ((*lock & (LOCK_OWNER_MASK)) != id)
 	{
 		// outbyte('u');
 		return RTOS_ERROR_FAILED;
 	}
 
-	__asm__ __volatile__ ("DMB");
+	__asm__ __volatile__ ("DMB" : : : "memory");
 
-	*lock = 0;
+	// Serve the next ticket, the count must not carry into the ticket field.
+	do
+	{
+		__asm__ __volatile__("LDREX %0, [%1]" : "=&r" (value) : "r" (lock) : "memory");
+		value = (value & ~((LOCK_SERVING_MASK) | (LOCK_OWNER_MASK))) | ((value + (LOCK_SERVING_ONE)) & (LOCK_SERVING_MASK));
+		__asm__ __volatile__("STREX %0, %2, [%1]" : "=&r" (failed) : "r" (lock), "r" (value) : "memory");
+	} while (0 != failed);
 
-	__asm__ __volatile__ ("CLREX");
 	__asm__ __volatile__ ("DSB");
 	__asm__ __volatile__ ("SEV");
 
@@ -187,56 +304,37 @@ RTOS_RegInt volatile rtos_UnlockCpuMutex(volatile RTOS_CpuMutex *lock)
 }
 
 // Enter critical section on an SMP setup.
-// It acquires the lock with interrupts disabled, but if the lock is busy it waits (WFE) with interrupts enabled.
-// This is to allow the thread to be interrupted even while waiting to lock the OS to enter a critical section.
+// Interrupts are disabled before taking a ticket for the lock and stay disabled while waiting for it,
+// an interrupt handler on this CPU would need the same lock and it would be queued behind our own ticket.
+// The wait is bounded, every CPU ahead of us in the queue holds the lock for one critical section only.
 RTOS_Critical_State rtos_ARM_SMP_EnterCriticalSection(volatile RTOS_CpuMutex *lock)
 {
 	RTOS_Critical_State saved;
 	RTOS_Critical_State interrupts_off;
-	RTOS_CpuId cpu;
-	uint32_t id;
-	uint32_t lock_val;
-	uint32_t success;
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+	uint32_t spin_start;
+#endif
 	__asm__ __volatile__ ("\tMRS\t%0, CPSR" : "=r" (saved) : :);
 
 	if (0 == (0x80 & saved)) // Interrupts were enabled, we were not in a critical section.
 	{
 		interrupts_off = saved | 0xC0;
-
-		while (1)
-		{
-			__asm__ __volatile__ ("\tMSR\tCPSR, %0" : : "r" (interrupts_off) :);            // Disable Interrupts.
-			__asm__ __volatile__("DSB");
-			__asm__ __volatile__("LDREX %0,[%1]" : "=r" (lock_val) : "r" (lock) :);
-
-			if (0 == lock_val)
-			{
-				cpu = RTOS_CurrentCpu();
-				id = (LOCK_ID_MARKER) | cpu;
-
-				__asm__ __volatile__("STREX %0, %2, [%1]" : "=&r" (success) : "r" (lock) , "r" (id) :);
-
-				if (0 == success)
-				{
-					__asm__ __volatile__("DMB");
-					break;
-				}
-			}
-
-			__asm__ __volatile__ ("\tMSR\tCPSR, %0" : : "r" (saved) :);                   // Temporarily reenable interrupts.
-			__asm__ __volatile__("WFE");
-		}
-
+		__asm__ __volatile__ ("\tMSR\tCPSR, %0" : : "r" (interrupts_off) :);            // Disable Interrupts.
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+		spin_start = (uint32_t)RTOS_READ_CYCLE_COUNTER();
+#endif
+		rtos_LockCpuMutex(lock);
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+		rtos_AccountLockSpin((uint32_t)RTOS_READ_CYCLE_COUNTER() - spin_start);
+#endif
 	}
 	return saved;
 }
 
 #define RTOS_RESTORE_CONTEXT()	\
 { \
-	__asm__ volatile ("LDR		R0, =RTOS");		/* The address of the RTOS structure.*/ 	\
-	__asm__ volatile ("MRC		P15, 0, R1, C0, C0, 5"); /* Get CPU ID. */ \
-	__asm__ volatile ("AND		R1, R1, #0x0f");	/* Mask out bits. */ \
-	__asm__ volatile ("LDR		R0, [R0, R1, LSL #2]");		/* The Current Task structure pointer per CPU. */ \
+	__asm__ volatile ("MRC		P15, 0, R0, C13, C0, 4"); /* TPIDRPRW: the per CPU data of this CPU. */ \
+	__asm__ volatile ("LDR		R0, [R0]");		/* Its first field is the Current Task structure pointer. */ \
 	__asm__ volatile ("LDR		LR, [R0]");		/* The first field in the task structure is the stack pointer. */ \
 	RESTORE_NEON_REGISTERS()				/* Restore NEON Registers. */	\
 	__asm__ volatile ("LDMFD	LR!, {R0}");		/* POP SPSR value to R0. */ \
@@ -259,33 +357,61 @@ RTOS_Critical_State rtos_ARM_SMP_EnterCriticalSection(volatile RTOS_CpuMutex *lo
 	__asm__ volatile ("MRS		R0, SPSR");		/* Read SPSR. */ \
 	__asm__ volatile ("STMDB	LR!, {R0}");		/* Push the SPSR value. */ \
 	SAVE_NEON_REGISTERS()					/* Save NEON registers. */ \
-	__asm__ volatile ("LDR		R0, =RTOS");		/* The address of the RTOS structure. */ \
-	__asm__ volatile ("MRC		P15, 0, R1, C0, C0, 5"); /* Get CPU ID. */ \
-	__asm__ volatile ("AND		R1, R1, #0x0f");	/* Mask out bits. */ \
-	__asm__ volatile ("LDR		R0, [R0, R1, LSL #2]");		/* The Current Task structure pointer per CPU. */ \
+	__asm__ volatile ("MRC		P15, 0, R0, C13, C0, 4"); /* TPIDRPRW: the per CPU data of this CPU. */ \
+	__asm__ volatile ("LDR		R0, [R0]");		/* Its first field is the Current Task structure pointer. */ \
 	__asm__ volatile ("STR		LR, [R0]");		/* Store the stack pointer in the task structure. */ \
 }
 
+// Keep the address of the per CPU data in TPIDRPRW (privileged only thread ID register), see rtos_ThisCpu().
+static void rtos_SetThisCpu(RTOS_CpuId cpu)
+{
+	__asm__ __volatile__ ("MCR p15, 0, %0, c13, c0, 4" : : "r" (&(RTOS.PerCpu[cpu])));
+}
+
+void rtos_CPUxIsr(void)
+{
+	rtos_arm_WritePeripheralReg(ARM_REG_ICCEOIR, rtos_arm_ReadPeripheralReg(ARM_REG_ICCIAR));
+}
+
 // Hold CPUs that have nothing to do.
 // CPU's that don't process real interrupts (not an SGI to trigger the scheduler) can sit here and wait for work.
+// A parked CPU does not touch the OS lock until its 'work available' flag is set by rtos_SignalCpus(),
+// the secondary CPUs sleep in WFI and are woken by the SGI itself. CPU 0 also owns the device interrupts,
+// which must stay pending for its IRQ handler, so it waits in WFE instead and only rechecks its flag on each event.
 static void rtos_CpuHoldingPenLoop(void)
 {
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
+	RTOS_PerCpu *perCpu = rtos_ThisCpu();
 
-	if (0 != RTOS.CurrentTasks[cpu])
+	if (0 != perCpu->CurrentTask)
 	{
 		return;
 	}
 
 	RTOS.CpuHoldingPen = RTOS_CpuMask_AddCpu(RTOS.CpuHoldingPen, cpu);
 
-	while(0 == RTOS.CurrentTasks[cpu])
+	while(0 == perCpu->CurrentTask)
 	{
+		// Clear the flag while still holding the lock, so a request to run the scheduler made after the scheduler has
+		// run here (by another CPU holding the lock in turn) cannot be lost. Not every change to the ready tasks is
+		// signalled though, only the CPUs chosen by rtos_CpusToReschedule() are woken up.
+		rtos_CpuWorkAvailable[cpu].WorkAvailable = 0;
 		rtos_UnlockCpuMutex(RTOS_OS_LOCK);
-		__asm__ __volatile__ ("WFE");		// Consume flag from SEV in the preceeding rtos_UnlockCpuMutex().
-		__asm__ __volatile__ ("NOP");
-		// outbyte(cpu ? 'l' : 'L');
-		__asm__ __volatile__ ("WFE");		// Wait for an event coming from another CPU.
+
+		while (0 == rtos_CpuWorkAvailable[cpu].WorkAvailable)
+		{
+			if (0 == cpu)
+			{
+				__asm__ __volatile__ ("WFE");
+			}
+			else
+			{
+				__asm__ __volatile__ ("WFI");	// Wakes up on the pending SGI even with interrupts disabled.
+				rtos_CPUxIsr();			// Acknowledge it, nothing else is routed to this CPU.
+			}
+			__asm__ __volatile__ ("DMB");
+		}
+
 		rtos_LockCpuMutex(RTOS_OS_LOCK);
 		rtos_Scheduler();
 	}
@@ -293,7 +419,6 @@ static void rtos_CpuHoldingPenLoop(void)
 	RTOS.CpuHoldingPen = RTOS_CpuMask_RemoveCpu(RTOS.CpuHoldingPen, cpu);
 }
 
-
 extern void rtos_InitCpu(void);
 // #define COMM_VAL  (*(volatile unsigned long *)(0xFFFF0000))
 extern void Xil_DCacheFlushLine(unsigned int adr);
@@ -314,11 +439,6 @@ void rtos_StartCpu()
 	}
 }
 
-void rtos_CPUxIsr(void)
-{
-	rtos_arm_WritePeripheralReg(ARM_REG_ICCEOIR, rtos_arm_ReadPeripheralReg(ARM_REG_ICCIAR));
-}
-
 void rtos_SecondaryCpu(void)
 {
 	RTOS_CpuId thisCpu = RTOS_CurrentCpu();
@@ -327,11 +447,16 @@ void rtos_SecondaryCpu(void)
 
 	RTOS_DisableInterrupts();
 
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	rtos_StartCycleCounter();
+#endif
+
 	// Set up Software Generated Interrup (SGI) handling.
 	rtos_arm_WritePeripheralReg(ARM_REG_ICCPMR, 0xF0);
 	rtos_arm_WritePeripheralReg(ARM_REG_ICCICR, 0x07);
 	rtos_arm_WritePeripheralReg(ARM_REG_ICDISER, 1);
 
+	rtos_SetThisCpu(thisCpu);
 	RTOS.Cpus = RTOS_CpuMask_AddCpu(RTOS.Cpus, thisCpu);
 
 	__asm__ __volatile__ ("DSB");
@@ -347,6 +472,7 @@ void rtos_SecondaryCpu(void)
 
 	rtos_LockCpuMutex(RTOS_OS_LOCK);
 	RTOS_CURRENT_TASK() =  0;
+	rtos_Scheduler();	// Tasks may have been waiting for this CPU since before it got here, nobody is going to signal it about those.
 	rtos_CpuHoldingPenLoop();
 
 	currentStackFrame =  (rtos_StackFrame *)(RTOS_CURRENT_TASK()->SP);
@@ -379,7 +505,8 @@ void rtos_SecondaryCpu(void)
 	__asm__ volatile ("SUBS		PC, LR, #4");		/* Update program counter. */ \
 }
 
-#define RTOS_SAVE_CONTEXT()	\
+// Push the complete context on the stack of the interrupted task, its new stack pointer is left in LR.
+#define RTOS_PUSH_CONTEXT()	\
 { \
 	__asm__ volatile ("STMDB	SP!, {R0}");		/* Push R0. */ \
 	__asm__ volatile ("STMDB	SP,{SP}^");		/* [SP - 4] <-- 'user mode SP'. */ \
@@ -392,21 +519,55 @@ void rtos_SecondaryCpu(void)
 	__asm__ volatile ("MRS		R0, SPSR");		/* Read SPSR. */ \
 	__asm__ volatile ("STMDB	LR!, {R0}");		/* Push the SPSR value. */ \
 	SAVE_NEON_REGISTERS()					/* Save NEON registers. */ \
+}
+
+#define RTOS_SAVE_CONTEXT()	\
+{ \
+	RTOS_PUSH_CONTEXT()					/* Save all registers. */ \
 	__asm__ volatile ("LDR		R0, =RTOS");		/* The address of the RTOS structure. */ \
 	__asm__ volatile ("LDR		R0, [R0]");		/* The first field points to the Current task structure.*/ \
 	__asm__ volatile ("STR		LR, [R0]");		/* Store the stack pointer in the task structure. */ \
 }
+
+// The registers the C code called by an interrupt handler is allowed to change (AAPCS), they are saved on the IRQ stack
+// together with the current task. The stack stays 8 byte aligned.
+#if (RTOS_ARM_NEON_SUPPORT) && !(RTOS_ARM_LAZY_NEON)
+#define SAVE_SCRATCH_REGISTERS()	__asm__ volatile ("STMDB	SP!, {R0-R3, R12, LR}");	\
+					__asm__ volatile ("LDR		R0, =RTOS");			\
+					__asm__ volatile ("LDR		R0, [R0]");			\
+					__asm__ volatile ("VMRS		R1, FPSCR");			\
+					__asm__ volatile ("STMDB	SP!, {R0, R1}");		\
+					__asm__ volatile ("VSTMDB	SP!, {D16-D31}");		\
+					__asm__ volatile ("VSTMDB	SP!, {D0-D7}");
+
+// Restores everything but R0-R3, R12 and LR, the task that was current on entry is left in R0.
+#define RESTORE_SCRATCH_REGISTERS()	__asm__ volatile ("VLDMIA	SP!, {D0-D7}");			\
+					__asm__ volatile ("VLDMIA	SP!, {D16-D31}");		\
+					__asm__ volatile ("LDMIA	SP!, {R0, R1}");		\
+					__asm__ volatile ("VMSR		FPSCR, R1");
+#else
+#define SAVE_SCRATCH_REGISTERS()	__asm__ volatile ("STMDB	SP!, {R0-R3, R12, LR}");	\
+					__asm__ volatile ("LDR		R0, =RTOS");			\
+					__asm__ volatile ("LDR		R0, [R0]");			\
+					__asm__ volatile ("STMDB	SP!, {R0, R1}");
+
+#define RESTORE_SCRATCH_REGISTERS()	__asm__ volatile ("LDMIA	SP!, {R0, R1}");
+#endif
+
+// The task interrupted by an IRQ that caused a task switch, see rtos_Isr_Handler().
+RTOS_Task *rtos_arm_InterruptedTask;
 #endif /* RTOS_SMP */
 
 #if defined(RTOS_SMP)
 void rtos_DispatchScheduler(void)
 {
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
-	rtos_StackFrame *currentStackFrame =  (rtos_StackFrame *)(RTOS.CurrentTasks[cpu]->SP);
+	RTOS_PerCpu *perCpu = rtos_ThisCpu();
+	rtos_StackFrame *currentStackFrame =  (rtos_StackFrame *)(perCpu->CurrentTask->SP);
 	uint32_t code = *(uint32_t *)(currentStackFrame->regs[15] - 8); // The SWI instruction.
 
 
-	RTOS.InterruptNesting[cpu]++;
+	perCpu->InterruptNesting++;
 	__asm__ __volatile__ ("DSB");
 
 	uint32_t spsr = currentStackFrame->spsr;
@@ -425,32 +586,31 @@ void rtos_DispatchScheduler(void)
 		case 0:	
 			rtos_Scheduler();		// Run the scheduler.
 
-			while (0 == RTOS.CurrentTasks[cpu])
+			while (0 == perCpu->CurrentTask)
 			{
 				rtos_CpuHoldingPenLoop();
 			}
 
-			RTOS_CpuMask otherCpus = RTOS_CpuMask_RemoveCpu(RTOS.Cpus, cpu);
-
-			if (0 != otherCpus)
-			{
-				rtos_SignalCpus(otherCpus);
-			}
+			// Only interrupt the CPUs that now have to run a task that became ready.
+			rtos_SignalCpus(rtos_CpusToReschedule(cpu));
 			break;
 
 		case 1:
 			rtos_SchedulerForYield();	// Yield.
 
-			while (0 == RTOS.CurrentTasks[cpu])
+			while (0 == perCpu->CurrentTask)
 			{
 				rtos_CpuHoldingPenLoop();
 			}
+
+			// The yielding task may now be picked up by a CPU waiting in the holding pen.
+			rtos_SignalCpus(rtos_CpusToReschedule(cpu));
 			break;
 		default:
 			break;
 	}
 
-	currentStackFrame =  (rtos_StackFrame *)(RTOS.CurrentTasks[cpu]->SP);
+	currentStackFrame =  (rtos_StackFrame *)(perCpu->CurrentTask->SP);
 	spsr = currentStackFrame->spsr;
 
 	if (0 == (0x80 & spsr))
@@ -458,7 +618,7 @@ void rtos_DispatchScheduler(void)
 		rtos_UnlockCpuMutex(RTOS_OS_LOCK);
 	}
 
-	RTOS.InterruptNesting[cpu]--;
+	perCpu->InterruptNesting--;
 
 	__asm__ __volatile__ ("DSB");
 }
@@ -510,21 +670,29 @@ extern void IRQInterrupt(void);
 void rtos_Isr(void)
 {
 	RTOS_CpuId cpu = RTOS_CurrentCpu();
+	RTOS_PerCpu *perCpu = rtos_ThisCpu();
 	RTOS_CpuMask otherCpus = 0;
 	RTOS_TaskSet runnableTasks;
+	RTOS_Task *previous;
 	rtos_StackFrame *currentStackFrame;
 	uint32_t spsr;
 
-	RTOS.InterruptNesting[cpu]++;
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
+	perCpu->InterruptNesting++;
 
 	__asm__ __volatile__ ("DSB");
 
 	rtos_LockCpuMutex(RTOS_OS_LOCK);
 
 	runnableTasks = RTOS.ReadyToRunTasks;
+	previous = perCpu->CurrentTask;
 
 	// rtos_Debug();
 
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
+
 	if (0 == cpu)
 	{
 		IRQInterrupt();
@@ -534,16 +702,19 @@ void rtos_Isr(void)
 		rtos_CPUxIsr();
 	}
 
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
+
 	rtos_Scheduler();
 
-	while (0 == RTOS.CurrentTasks[cpu])
+	while (0 == perCpu->CurrentTask)
 	{
 		rtos_CpuHoldingPenLoop();
 	}
 
-	if (runnableTasks != RTOS.ReadyToRunTasks)
+	// A task preempted here (e.g. by the task an SGI was sent for) may have to move to another CPU.
+	if ((runnableTasks != RTOS.ReadyToRunTasks) || (previous != perCpu->CurrentTask))
 	{
-		otherCpus = RTOS_CpuMask_RemoveCpu(RTOS.Cpus, cpu);		// All CPUs except the current one.
+		otherCpus = rtos_CpusToReschedule(cpu);		// The CPUs outranked by a task that is ready but not running.
 	}
 
 	currentStackFrame =  (rtos_StackFrame *)(RTOS_CURRENT_TASK()->SP);
@@ -554,7 +725,7 @@ void rtos_Isr(void)
 		rtos_UnlockCpuMutex(RTOS_OS_LOCK);
 	}
 
-	RTOS.InterruptNesting[cpu]--;
+	perCpu->InterruptNesting--;
 	__asm__ __volatile__ ("DSB");
 
 	if (0 != otherCpus)
@@ -566,15 +737,24 @@ void rtos_Isr(void)
 #else
 void rtos_Isr(void)
 {
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
 	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
 	IRQInterrupt();
-	rtos_Scheduler();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
 	RTOS.InterruptNesting--;
 }
 #endif
 
 void rtos_Isr_Handler(void) __attribute__((naked));
 
+#if defined(RTOS_SMP)
 void rtos_Isr_Handler(void)
 {
 	RTOS_SAVE_CONTEXT();
@@ -583,8 +763,156 @@ void rtos_Isr_Handler(void)
 	__asm__ __volatile__ ("CLREX");
 	RTOS_RESTORE_CONTEXT();	
 }
+#else
+// Most interrupts do not switch tasks (see rtos_IsRescheduleNeeded()), so only the scratch registers are saved up front.
+// The full context of the interrupted task is only saved (and the one of the new task restored) if rtos_Isr() has switched tasks.
+void rtos_Isr_Handler(void)
+{
+	SAVE_SCRATCH_REGISTERS();
+	__asm__ __volatile__ ("CLREX");
+	__asm volatile( "bl rtos_Isr" );
+	__asm__ __volatile__ ("CLREX");
+	RESTORE_SCRATCH_REGISTERS();
+	__asm__ volatile ("LDR		R1, =RTOS");
+	__asm__ volatile ("LDR		R1, [R1]");		/* The current task after the interrupt. */
+	__asm__ volatile ("CMP		R0, R1");
+	__asm__ volatile ("BNE		1f");
+	__asm__ volatile ("LDMIA	SP!, {R0-R3, R12, LR}");	/* Same task: just return to it. */
+	__asm__ volatile ("SUBS		PC, LR, #4");
+	__asm__ volatile ("1:");
+	__asm__ volatile ("LDR		R1, =rtos_arm_InterruptedTask");
+	__asm__ volatile ("STR		R0, [R1]");
+	__asm__ volatile ("LDMIA	SP!, {R0-R3, R12, LR}");	/* All registers are as they were when the interrupt was taken. */
+	RTOS_PUSH_CONTEXT();
+	__asm__ volatile ("LDR		R0, =rtos_arm_InterruptedTask");
+	__asm__ volatile ("LDR		R0, [R0]");
+	__asm__ volatile ("STR		LR, [R0]");		/* Store the stack pointer in the interrupted task. */
+	RTOS_RESTORE_CONTEXT();	
+}
+#endif
 
 
+#if (RTOS_ARM_LAZY_NEON)
+// -------------------------------------------------------------------------------------------------------------------------------
+// Lazy NEON/VFP context switching.
+
+// The task whose NEON/VFP state is in the registers, 0 if none.
+RTOS_Task *rtos_arm_NeonOwner;
+
+// Where rtos_Undefined_Handler() saves the registers to (0: nothing to save) and loads them from, set by rtos_arm_NeonTrap().
+volatile struct rtos_NeonContext *rtos_arm_NeonSaveTo;
+volatile struct rtos_NeonContext *rtos_arm_NeonLoadFrom;
+
+// Called on an undefined instruction exception (interrupts are disabled).
+// If the instruction was executed by a task while the unit was disabled because that task did not own it, the unit is given
+// to the task and 1 is returned: the handler switches the registers and restarts the instruction.
+// Anything else is a real undefined instruction, NEON/VFP used by an exception handler or by a task that has opted out.
+uint32_t rtos_arm_NeonTrap(uint32_t spsr)
+{
+	RTOS_Task *task = RTOS.CurrentTask;
+	uint32_t fpexc;
+
+	__asm__ volatile ("VMRS %0, FPEXC" : "=r" (fpexc));
+
+	if ((0 != (0x40000000 & fpexc)) || (0x1F != (0x1F & spsr)) || (0 == task) || task->NeonContext.disabled)
+	{
+		return 0;
+	}
+
+	rtos_arm_NeonSaveTo = (0 == rtos_arm_NeonOwner) ? 0 : &(rtos_arm_NeonOwner->NeonContext);
+	rtos_arm_NeonLoadFrom = &(task->NeonContext);
+	rtos_arm_NeonOwner = task;
+
+	return 1;
+}
+
+void rtos_Undefined_Handler(void) __attribute__((naked));
+
+void rtos_Undefined_Handler(void)
+{
+	__asm__ volatile ("STMDB	SP!, {R0-R3, R12, LR}");
+	__asm__ volatile ("MRS		R0, SPSR");
+	__asm__ volatile ("BL		rtos_arm_NeonTrap");
+	__asm__ volatile ("CMP		R0, #0");
+	__asm__ volatile ("BEQ		2f");
+	__asm__ volatile ("MOV		R0, #0x40000000");
+	__asm__ volatile ("VMSR		FPEXC, R0");			/* Enable the unit. */
+	__asm__ volatile ("LDR		R0, =rtos_arm_NeonSaveTo");
+	__asm__ volatile ("LDR		R0, [R0]");
+	__asm__ volatile ("CMP		R0, #0");
+	__asm__ volatile ("BEQ		1f");
+	__asm__ volatile ("VSTMIA	R0!, {D0-D15}");		/* Save the registers of the previous owner. */
+	__asm__ volatile ("VSTMIA	R0!, {D16-D31}");
+	__asm__ volatile ("VMRS		R1, FPSCR");
+	__asm__ volatile ("STR		R1, [R0]");
+	__asm__ volatile ("1:");
+	__asm__ volatile ("LDR		R0, =rtos_arm_NeonLoadFrom");
+	__asm__ volatile ("LDR		R0, [R0]");
+	__asm__ volatile ("VLDMIA	R0!, {D0-D15}");		/* Load the registers of the current task. */
+	__asm__ volatile ("VLDMIA	R0!, {D16-D31}");
+	__asm__ volatile ("LDR		R1, [R0]");
+	__asm__ volatile ("VMSR		FPSCR, R1");
+	__asm__ volatile ("MRS		R0, SPSR");
+	__asm__ volatile ("TST		R0, #0x20");			/* Thumb state? */
+	__asm__ volatile ("LDMIA	SP!, {R0-R3, R12, LR}");
+	__asm__ volatile ("BNE		3f");
+	__asm__ volatile ("SUBS		PC, LR, #4");			/* Restart the instruction (ARM). */
+	__asm__ volatile ("3:");
+	__asm__ volatile ("SUBS		PC, LR, #2");			/* Restart the instruction (Thumb). */
+	__asm__ volatile ("2:");
+	__asm__ volatile ("B		2b");				/* Not a NEON/VFP instruction we can help with. */
+}
+
+// Called inside a critical section.
+void rtos_arm_ReleaseNeon(RTOS_Task *task)
+{
+	if (task == rtos_arm_NeonOwner)
+	{
+		rtos_arm_NeonOwner = 0;
+	}
+}
+
+RTOS_RegInt RTOS_SetTaskUsesFpu(RTOS_Task *task, RTOS_RegInt usesFpu)
+{
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == task)
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	task->NeonContext.disabled = !usesFpu;
+
+	if ((!usesFpu) && (task == rtos_arm_NeonOwner))
+	{
+		rtos_arm_NeonOwner = 0;
+
+		if (task == RTOS_CURRENT_TASK())
+		{
+			__asm__ volatile ("VMSR FPEXC, %0" : : "r" (0));
+		}
+	}
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_OK;
+}
+#else
+void rtos_Undefined_Handler(void) __attribute__((naked));
+
+void rtos_Undefined_Handler(void)
+{
+	__asm__ volatile ("1:");
+	__asm__ volatile ("B		1b");
+}
+#endif
+
 // -------------------------------------------------------------------------------------------------------------------------------
 void RTOS_DefaultIdleFunction(void *p)
 {
@@ -601,12 +929,27 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 {
 	rtos_StackFrame *sp;
 #if (RTOS_ARM_NEON_SUPPORT)
+#if !(RTOS_ARM_LAZY_NEON)
 	volatile uint32_t tmp;
+#endif
 	int i;
 #endif	
+#if (RTOS_ARM_LAZY_NEON)
+	for (i = 0; i < 32; i++)
+	{
+		task->NeonContext.dregs[i] = 0;
+	}
+	task->NeonContext.fpscr = 0;
+	task->NeonContext.disabled = 0;
+	rtos_arm_ReleaseNeon(task);
+#endif
+
 	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
 	if (0 != task->SP0)
 	{
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
 		task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 		sp = (rtos_StackFrame *)(task->SP);
 		sp->spsr = 0x1F;
@@ -626,7 +969,7 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 		sp->regs[2] = 0x2; 
 		sp->regs[1] = 0x1; 
 		sp->regs[0] = 0x0;
-#if (RTOS_ARM_NEON_SUPPORT)
+#if (RTOS_ARM_NEON_SUPPORT) && !(RTOS_ARM_LAZY_NEON)
 		for (i = 0; i < 32; i++)
 		{
 			sp->neon_dregs[i] = 0;
@@ -650,8 +993,12 @@ void rtos_SecondaryCpu(void)
 int RTOS_StartMultitasking(void)
 {
 	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
+#if defined(RTOS_USE_CYCLE_COUNTER)
+	rtos_StartCycleCounter();
+#endif
 #if defined(RTOS_SMP)
 	 RTOS_CpuId thisCpu = RTOS_CurrentCpu();
+	 rtos_SetThisCpu(thisCpu);
 	 RTOS.Cpus = RTOS_CpuMask_AddCpu(0, thisCpu);
 	 // xil_printf("[%d] PRRR=%x\r\n", thisCpu, readPRRR());
 	 *(RTOS_OS_LOCK) = 0;
@@ -52,6 +52,7 @@
 #define RTOS_IsInsideIsr() (0x1f != (0x1f & rtos_readCPSR()))
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 == ((X) & 0x80))	/* CPSR I bit. */
 
 #if defined(RTOS_SMP)
 extern RTOS_RegInt volatile rtos_LockCpuMutex(volatile RTOS_CpuMutex *lock);
@@ -64,18 +65,18 @@ extern RTOS_RegInt volatile rtos_UnlockCpuMutex(volatile RTOS_CpuMutex *lock);
 #if 1
 extern RTOS_Critical_State rtos_ARM_SMP_EnterCriticalSection(volatile RTOS_CpuMutex *lock);
 
-#define RTOS_EnterCriticalSection(X) (X) = rtos_ARM_SMP_EnterCriticalSection(RTOS_OS_LOCK)
+#define rtos_TargetEnterCriticalSection(X) (X) = rtos_ARM_SMP_EnterCriticalSection(RTOS_OS_LOCK)
 
 #else
-#define RTOS_EnterCriticalSection(X) \
+#define rtos_TargetEnterCriticalSection(X) \
 		do { rtos_disableInterrupts(X); if (0 == (0x80 & (X))) rtos_LockCpuMutex(RTOS_OS_LOCK); } while(0)
 #endif
 
-#define RTOS_ExitCriticalSection(X)	\
+#define rtos_TargetExitCriticalSection(X)	\
 	do { if (0 == (0x80 & (X))) rtos_UnlockCpuMutex(RTOS_OS_LOCK); rtos_restoreInterrupts(X); } while(0)
 #else
-#define RTOS_EnterCriticalSection(X)	rtos_disableInterrupts(X)
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
 #endif
 
 
@@ -100,6 +101,13 @@ extern RTOS_Critical_State rtos_ARM_SMP_EnterCriticalSection(volatile RTOS_CpuMu
 	res;})
 #endif
 
+// The PMU cycle counter (PMCCNTR), started by rtos_StartCycleCounter().
+#define RTOS_READ_CYCLE_COUNTER() ({ uint32_t rtos_ccnt; __asm__ __volatile__ ("MRC p15, 0, %0, c9, c13, 0" : "=r" (rtos_ccnt)); rtos_ccnt; })
+
+// L1 data cache refills of the calling CPU, for benchmarks.
+extern uint32_t rtos_arm_ReadCacheMisses(void);
+#define RTOS_READ_CACHE_MISS_COUNTER() rtos_arm_ReadCacheMisses()
+
 #define RTOS_INVOKE_SCHEDULER() __asm volatile ( "SWI 0" ) 
 #define RTOS_INVOKE_YIELD() __asm volatile ( "SWI 1" ) 
 
@@ -110,6 +118,13 @@ extern RTOS_Critical_State rtos_ARM_SMP_EnterCriticalSection(volatile RTOS_CpuMu
 	rtos__current_cpuid; \
 })
 
+// The per CPU data of the executing CPU, its address is kept in TPIDRPRW on each CPU.
+// Only valid after RTOS_StartMultitasking() (or rtos_SecondaryCpu()) has set it up.
+#define rtos_ThisCpu() ({ RTOS_PerCpu *rtos__this_cpu;	\
+	__asm__ __volatile__ ("\tMRC     p15, 0, %0, c13, c0, 4\n" : "=r" (rtos__this_cpu)); \
+	rtos__this_cpu; \
+})
+
 #define RTOS_CpuMask_AddCpu(MASK, CPU) ((MASK) | (1UL << (CPU)))
 #define RTOS_CpuMask_RemoveCpu(MASK, CPU) ((MASK) & (~(1UL << (CPU))))
 #define RTOS_CpuMask_IsCpuIncluded(MASK, CPU) (0 != ((MASK) & (1UL << (CPU))))
@@ -124,6 +139,15 @@ extern void rtos_SignalCpus(RTOS_CpuMask cpus);
 
 #define RTOS_TASK_EXEC_LOCATION(TASK) ((rtos_StackFrame *)((TASK)->SP))->regs[15]
 
+#if (RTOS_ARM_LAZY_NEON)
+// Tasks may use NEON/VFP by default, a task that never does can opt out, then any NEON/VFP instruction it executes is fatal.
+extern RTOS_RegInt RTOS_SetTaskUsesFpu(RTOS_Task *task, RTOS_RegInt usesFpu);
+
+// Forget the NEON registers of a task that is going away.
+extern void rtos_arm_ReleaseNeon(RTOS_Task *task);
+#define rtos_TargetTaskKilled(TASK) rtos_arm_ReleaseNeon(TASK)
+#endif
+
 // Utility functions.
 #define RTOS_DEFAULT_IDLE_FUNCTION RTOS_DefaultIdleFunction
 extern void RTOS_DefaultIdleFunction(void *p);
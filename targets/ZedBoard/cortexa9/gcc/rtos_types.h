@@ -29,6 +29,26 @@
 #define RTOS_ARM_NEON_SUPPORT 1
 #endif
 
+// Lazy NEON/VFP context switching: the NEON registers are not part of the saved context of a task, the unit is
+// disabled whenever a task that does not own the register contents is switched in and the first NEON/VFP
+// instruction that task executes traps (undefined instruction) to switch the registers over (see rtos_arm_NeonTrap()).
+// Tasks that never use floating point or NEON never pay for it.
+// This is opt-in: interrupt handlers (and everything they call, e.g. a NEON memcpy()) must not touch NEON/VFP at all,
+// since the IRQ path then no longer saves the scratch NEON registers.
+// Only the single CPU configuration is supported, with SMP the registers are always switched with the rest of the context.
+#if !defined(RTOS_ARM_LAZY_NEON)
+#	define RTOS_ARM_LAZY_NEON 0
+#endif
+
+#if (RTOS_ARM_LAZY_NEON)
+#	if !(RTOS_ARM_NEON_SUPPORT)
+#		error RTOS_ARM_LAZY_NEON needs RTOS_ARM_NEON_SUPPORT.
+#	endif
+#	if defined(RTOS_SMP)
+#		error RTOS_ARM_LAZY_NEON is not supported with SMP.
+#	endif
+#endif
+
 // Type to store saved flags e.g. when we enter and exit critical state.
 typedef uint32_t RTOS_Critical_State;
 
@@ -36,7 +56,7 @@ typedef uint32_t RTOS_StackItem_t;
 
 struct rtos_StackFrame
 {
-#if (RTOS_ARM_NEON_SUPPORT)
+#if (RTOS_ARM_NEON_SUPPORT) && !(RTOS_ARM_LAZY_NEON)
 	uint32_t fpexc;
 	uint32_t fpscr;
 	uint64_t neon_dregs[32];
@@ -47,6 +67,18 @@ struct rtos_StackFrame
 
 typedef struct rtos_StackFrame rtos_StackFrame;
 
+#if (RTOS_ARM_LAZY_NEON)
+// The NEON registers of a task, only written when another task needs the unit.
+struct rtos_NeonContext
+{
+	uint64_t dregs[32];
+	uint32_t fpscr;
+	uint32_t disabled;		// The task never uses NEON/VFP (see RTOS_SetTaskUsesFpu()).
+};
+
+#define RTOS_TARGET_SPECIFIC_TASK_DATA	struct rtos_NeonContext NeonContext;
+#endif
+
 // This is needed when we create stack frames for tasks that haven't started yet.
 #define RTOS_INITIAL_STACK_DEPTH (sizeof(rtos_StackFrame) + 8)
 
@@ -65,6 +97,8 @@ typedef struct rtos_StackFrame rtos_StackFrame;
 
 #define RTOS_MIN_STACK_SIZE 512 /* What is the real number? */
 
+#define RTOS_CACHE_LINE_SIZE 32		/* Cortex-A9 L1 data cache line. */
+
 #if defined(RTOS_SMP)
 typedef uint32_t RTOS_CpuId;
 #define RTOS_CPUID_NO_CPU ((RTOS_CpuId)(-1))
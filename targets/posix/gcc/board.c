@@ -0,0 +1,87 @@
+#include <stdint.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <rtos.h>
+#include <rtos_internals.h>
+#include <board.h>
+#include "interrupts.h"
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Console I/O goes straight to the file descriptors, stdio is not safe to use from simulated interrupts.
+void Board_Putc(char c)
+{
+	while ((-1 == write(1, &c, 1)) && (EINTR == errno));
+}
+
+void Board_Puts(const char *str)
+{
+	if (0 == str)
+	{
+		return;
+	}
+	while (*str)
+	{
+		Board_Putc(*str++);
+	}
+}
+
+// Blocks the whole process, but the timer signal still interrupts the read() and switches tasks.
+char Board_Getc(void)
+{
+	char c;
+
+	while (1 != read(0, &c, 1))
+	{
+		if (EINTR != errno)
+		{
+			return 0;
+		}
+	}
+
+	return c;
+}
+
+// A simulation build has no timer, see Board_SimulateCpuBurst().
+void Board_InitTimer(void)
+{
+#if !defined(RTOS_SIMULATION)
+	struct itimerval timer;
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / (RTOS_TICKS_PER_SECOND);
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_REAL, &timer, 0);
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+int Board_HardwareInit(void)
+{
+	RTOS_DisableInterrupts();
+	InitInterrupts();
+	Board_InitTimer();
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef BOARD_H
+#define BOARD_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+extern void Board_Putc(char c);
+extern void Board_Puts(const char *s);
+extern char Board_Getc(void);
+
+extern int Board_HardwareInit(void);
+
+// A software interrupt, the handler calls Board_SoftwareInterruptHook (if set) in interrupt context.
+extern void (*Board_SoftwareInterruptHook)(void);
+extern void Board_RaiseSoftwareInterrupt(void);
+#define Board_RaiseSoftwareInterrupt Board_RaiseSoftwareInterrupt
+
+#if defined(RTOS_SIMULATION)
+// Virtual time: a task's CPU burst of 'ticks' ticks, see interrupts.c.
+extern void Board_SimulateCpuBurst(RTOS_Time ticks);
+#define Board_SimulateCpuBurst Board_SimulateCpuBurst
+#endif
+
+#endif
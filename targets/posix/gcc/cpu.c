@@ -0,0 +1,529 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <rtos.h>
+#include <rtos_internals.h>
+#include <board.h>
+#include "interrupts.h"
+#if defined(RTOS_SMP)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// 'Interrupts' are disabled until the first task starts running.
+RTOS_POSIX_PER_CPU volatile uint32_t rtos_posix_InterruptsDisabled = 1;
+
+// Stacks allocated for tasks created with a stack too small to take a signal frame.
+// The same replacement is handed out again if a task is re-created with the same stack (e.g. after RTOS_KillTask()).
+#define RTOS_POSIX_REPLACED_STACKS ((RTOS_Priority_Highest) + 1)
+
+static struct
+{
+	void	*Original;
+	void	*Replacement;
+} rtos_posix_ReplacedStacks[RTOS_POSIX_REPLACED_STACKS];
+
+static void *rtos_posix_ReplaceStack(void *sp0)
+{
+	unsigned int i;
+
+	for (i = 0; i < (RTOS_POSIX_REPLACED_STACKS); i++)
+	{
+		if (sp0 == rtos_posix_ReplacedStacks[i].Original)
+		{
+			return rtos_posix_ReplacedStacks[i].Replacement;
+		}
+
+		if (0 == rtos_posix_ReplacedStacks[i].Original)
+		{
+			rtos_posix_ReplacedStacks[i].Replacement = malloc(RTOS_POSIX_STACK_BYTES);
+
+			if (0 != rtos_posix_ReplacedStacks[i].Replacement)
+			{
+				rtos_posix_ReplacedStacks[i].Original = sp0;
+			}
+
+			return rtos_posix_ReplacedStacks[i].Replacement;
+		}
+	}
+
+	return 0;
+}
+
+extern void rtos_TaskEntryPoint(void);
+
+void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
+{
+	ucontext_t *context = (ucontext_t *)&(task->Context);
+	void *stack;
+
+	// There is no stack frame to point to, SP points to the saved context instead.
+	task->SP = context;
+
+	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
+	if (0 != task->SP0)
+	{
+		if ((sizeof(RTOS_StackItem_t) * stackCapacity) < (RTOS_POSIX_STACK_BYTES))
+		{
+			stack = rtos_posix_ReplaceStack(task->SP0);
+			RTOS_ASSERT(0 != stack);
+			task->SP0 = stack;
+			stackCapacity = (RTOS_POSIX_STACK_BYTES) / sizeof(RTOS_StackItem_t);
+		}
+
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
+		getcontext(context);
+		context->uc_stack.ss_sp = task->SP0;
+		context->uc_stack.ss_size = sizeof(RTOS_StackItem_t) * stackCapacity;
+		context->uc_link = 0;
+		sigemptyset(&(context->uc_sigmask));
+		makecontext(context, &rtos_TaskEntryPoint, 0);
+	}
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------
+// MULTI-CORE
+// Every CPU is a thread, CPU 0 is the thread that calls RTOS_StartMultitasking().
+// The OS lock is held across swapcontext(), the task that is switched to releases it (if its interrupts were enabled),
+// so a task's context is always completely saved before another CPU can pick it up.
+// A CPU without a task waits in the holding pen, which runs in the thread's own context on the thread's own stack.
+
+#if defined(RTOS_SMP)
+__thread RTOS_CpuId rtos_posix_CpuId;
+
+static pthread_t rtos_posix_CpuThreads[RTOS_SMP_CPU_CORES];
+static ucontext_t rtos_posix_HoldingPenContexts[RTOS_SMP_CPU_CORES];
+
+void rtos_SignalCpus(RTOS_CpuMask cpus)
+{
+	RTOS_CpuId cpu;
+
+	cpus &= RTOS.Cpus;
+
+	while (0 != cpus)
+	{
+		cpu = (RTOS_CpuId)__builtin_ctz(cpus);
+		cpus = RTOS_CpuMask_RemoveCpu(cpus, cpu);
+		pthread_kill(rtos_posix_CpuThreads[cpu], RTOS_POSIX_CPU_SIGNAL);
+	}
+}
+
+void rtos_SignalCpu(RTOS_CpuId cpu)
+{
+	if (RTOS_CPUID_NO_CPU != cpu)
+	{
+		rtos_SignalCpus(1UL << cpu);
+	}
+}
+
+#define LOCK_ID_MARKER 0x00008000
+
+#if !defined(RTOS_POSIX_LOCK_SPINS)
+#define RTOS_POSIX_LOCK_SPINS 1000
+#endif
+
+// Lock a mutex that prevents other CPUs from accessing a resource.
+RTOS_RegInt rtos_LockCpuMutex(volatile RTOS_CpuMutex *lock)
+{
+	uint32_t id = (LOCK_ID_MARKER) | RTOS_CurrentCpu();
+	uint32_t expected;
+	uint32_t spins;
+
+	while (1)
+	{
+		expected = 0;
+
+		if (__atomic_compare_exchange_n(lock, &expected, id, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+
+		// Wait for the lock to look free before trying again, reading does not steal the cache line from the owner.
+		// Unlike a real CPU the owner can be descheduled by the host, do not burn its time slice if it takes long.
+		for (spins = 0; 0 != *lock; spins++)
+		{
+			if ((RTOS_POSIX_LOCK_SPINS) > spins)
+			{
+				__builtin_ia32_pause();
+			}
+			else
+			{
+				sched_yield();
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Unlock a mutex that prevents other CPUs from accessing a resource.
+RTOS_RegInt rtos_UnlockCpuMutex(volatile RTOS_CpuMutex *lock)
+{
+	uint32_t id = (LOCK_ID_MARKER) | RTOS_CurrentCpu();
+
+	if (*lock != id)
+	{
+		return RTOS_ERROR_FAILED;
+	}
+
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+
+	return RTOS_OK;
+}
+
+// Enter critical section on an SMP setup, the OS is only locked by the outermost critical section.
+RTOS_Critical_State rtos_posix_SMP_EnterCriticalSection(volatile RTOS_CpuMutex *lock)
+{
+	RTOS_Critical_State saved = rtos_posix_InterruptsDisabled;
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+	uint32_t spin_start;
+#endif
+
+	if (0 == saved)
+	{
+		rtos_posix_InterruptsDisabled = 1;
+		__asm__ volatile ("" : : : "memory");
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+		spin_start = (uint32_t)RTOS_READ_CYCLE_COUNTER();
+#endif
+		rtos_LockCpuMutex(lock);
+#if defined(RTOS_INCLUDE_CRITICAL_PROFILING)
+		rtos_AccountLockSpin((uint32_t)RTOS_READ_CYCLE_COUNTER() - spin_start);
+#endif
+	}
+
+	return saved;
+}
+
+void rtos_posix_SMP_ExitCriticalSection(volatile RTOS_CpuMutex *lock, RTOS_Critical_State saved)
+{
+	if (0 == saved)
+	{
+		rtos_UnlockCpuMutex(lock);
+		rtos_posix_InterruptsDisabled = 0;
+		rtos_posix_DeliverPendingInterrupts();
+	}
+}
+
+// Called with 'interrupts' disabled and the OS locked after the scheduler has run, switches to the task it picked.
+// If there is nothing to run on this CPU it switches to the holding pen instead.
+void rtos_posix_SwitchTask(RTOS_Task *previous)
+{
+	RTOS_CpuId cpu = RTOS_CurrentCpu();
+	RTOS_Task *next = RTOS.PerCpu[cpu].CurrentTask;
+
+	if (previous != next)
+	{
+		swapcontext((ucontext_t *)&(previous->Context),
+			(0 != next) ? (ucontext_t *)&(next->Context) : &rtos_posix_HoldingPenContexts[cpu]);
+	}
+}
+
+// The equivalent of the software interrupt other ports use to invoke the scheduler.
+// select: 0 -- Scheduler
+// select: 1 -- Yield
+void rtos_posix_InvokeScheduler(int yield)
+{
+	RTOS_CpuId cpu;
+	RTOS_Task *previous;
+	RTOS_CpuMask otherCpus;
+	RTOS_Critical_State saved_state;
+
+	saved_state = rtos_posix_SMP_EnterCriticalSection(RTOS_OS_LOCK);
+	cpu = RTOS_CurrentCpu();
+	previous = RTOS.PerCpu[cpu].CurrentTask;
+	RTOS.PerCpu[cpu].InterruptNesting++;
+
+	if (0 == yield)
+	{
+		rtos_Scheduler();
+	}
+	else
+	{
+		rtos_SchedulerForYield();
+	}
+
+	RTOS.PerCpu[cpu].InterruptNesting--;
+
+	if (0 == yield)
+	{
+		otherCpus = rtos_CpusToReschedule(cpu);
+
+		if (0 != otherCpus)
+		{
+			rtos_SignalCpus(otherCpus);
+		}
+	}
+
+	rtos_posix_SwitchTask(previous);
+	rtos_posix_SMP_ExitCriticalSection(RTOS_OS_LOCK, saved_state);	// Possibly on a different CPU by now.
+}
+
+// The body of every CPU thread, called with interrupts disabled and the OS locked.
+// Runs the holding pen while there is no task for this CPU, otherwise switches to the task.
+// It gets control back (with the OS still locked) whenever the scheduler leaves this CPU without a task.
+static void rtos_posix_RunCpu(void)
+{
+	RTOS_CpuId cpu = RTOS_CurrentCpu();
+	RTOS_TaskSet runnableTasks;
+	RTOS_CpuMask otherCpus;
+	sigset_t signals;
+	sigset_t waitMask;
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGALRM);
+	sigaddset(&signals, RTOS_POSIX_CPU_SIGNAL);
+
+	while (1)
+	{
+		RTOS.CpuHoldingPen = RTOS_CpuMask_AddCpu(RTOS.CpuHoldingPen, cpu);
+
+		while (0 == RTOS.PerCpu[cpu].CurrentTask)
+		{
+			rtos_UnlockCpuMutex(RTOS_OS_LOCK);
+
+			// Block the signals before looking at the pending interrupts, so that one arriving in between is not lost.
+			pthread_sigmask(SIG_BLOCK, &signals, &waitMask);
+
+			if (!rtos_posix_HasPendingInterrupts())
+			{
+				sigsuspend(&waitMask);
+			}
+
+			pthread_sigmask(SIG_SETMASK, &waitMask, 0);
+
+			rtos_LockCpuMutex(RTOS_OS_LOCK);
+			runnableTasks = RTOS.ReadyToRunTasks;
+			rtos_posix_ServiceInterrupts();
+
+			RTOS.PerCpu[cpu].InterruptNesting++;
+			rtos_Scheduler();
+			RTOS.PerCpu[cpu].InterruptNesting--;
+
+			// Once this CPU has picked up a task the other ready tasks may be better off on other CPUs, look again.
+			if ((runnableTasks != RTOS.ReadyToRunTasks) || (0 != RTOS.PerCpu[cpu].CurrentTask))
+			{
+				otherCpus = rtos_CpusToReschedule(cpu);
+
+				if (0 != otherCpus)
+				{
+					rtos_SignalCpus(otherCpus);
+				}
+			}
+		}
+
+		RTOS.CpuHoldingPen = RTOS_CpuMask_RemoveCpu(RTOS.CpuHoldingPen, cpu);
+
+		swapcontext(&rtos_posix_HoldingPenContexts[cpu], (ucontext_t *)&(RTOS.PerCpu[cpu].CurrentTask->Context));
+	}
+}
+
+static void *rtos_posix_SecondaryCpu(void *arg)
+{
+	RTOS_CpuId thisCpu = (RTOS_CpuId)(uintptr_t)arg;
+
+	rtos_posix_CpuId = thisCpu;	// Interrupts are disabled, rtos_posix_InterruptsDisabled starts as 1 in every thread.
+	__atomic_fetch_or(&RTOS.Cpus, RTOS_CpuMask_AddCpu(0, thisCpu), __ATOMIC_SEQ_CST);
+
+	while (!__atomic_load_n(&RTOS.IsRunning, __ATOMIC_ACQUIRE))
+	{
+		sched_yield();
+	}
+
+	rtos_LockCpuMutex(RTOS_OS_LOCK);
+	RTOS_CURRENT_TASK() = 0;
+
+	// Tasks may have been waiting for this CPU since before it got here, nobody is going to signal it about those.
+	RTOS.PerCpu[thisCpu].InterruptNesting++;
+	rtos_Scheduler();
+	RTOS.PerCpu[thisCpu].InterruptNesting--;
+
+	rtos_posix_RunCpu();
+
+	return 0;
+}
+#else
+// Called with 'interrupts' disabled after the scheduler has run, switches to the task it picked.
+void rtos_posix_SwitchTask(RTOS_Task *previous)
+{
+	if (previous != RTOS.CurrentTask)
+	{
+		swapcontext((ucontext_t *)&(previous->Context), (ucontext_t *)&(RTOS.CurrentTask->Context));
+	}
+}
+
+// The equivalent of the software interrupt other ports use to invoke the scheduler.
+// select: 0 -- Scheduler
+// select: 1 -- Yield
+void rtos_posix_InvokeScheduler(int yield)
+{
+	RTOS_Task *previous;
+	RTOS_Critical_State saved_state;
+
+	rtos_disableInterrupts(saved_state);
+	RTOS.InterruptNesting++;
+	previous = RTOS.CurrentTask;
+
+	if (0 == yield)
+	{
+		rtos_Scheduler();
+	}
+	else
+	{
+		rtos_SchedulerForYield();
+	}
+
+	RTOS.InterruptNesting--;
+	rtos_posix_SwitchTask(previous);
+	rtos_restoreInterrupts(saved_state);
+}
+
+#endif /* RTOS_SMP */
+
+#if defined(RTOS_SIMULATION)
+// Virtual time in nanoseconds, it only moves in whole ticks.
+uint64_t rtos_posix_ReadClock(void)
+{
+	return (uint64_t)RTOS.Time * (1000000000ULL / (RTOS_TICKS_PER_SECOND));
+}
+#else
+uint64_t rtos_posix_ReadClock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+#endif
+
+// The counter is opened by the first call on each CPU thread and counts for that thread only.
+static __thread int rtos_posix_CacheMissFd = -2;
+
+uint32_t rtos_posix_ReadCacheMisses(void)
+{
+	struct perf_event_attr attr;
+	uint64_t count = 0;
+
+	if (-2 == rtos_posix_CacheMissFd)
+	{
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		rtos_posix_CacheMissFd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	if ((rtos_posix_CacheMissFd < 0) || (sizeof(count) != read(rtos_posix_CacheMissFd, &count, sizeof(count))))
+	{
+		return 0;
+	}
+
+	return (uint32_t)count;
+}
+// -------------------------------------------------------------------------------------------------------------------------------
+void RTOS_DefaultIdleFunction(void *p)
+{
+	while(1)
+	{
+#if defined(RTOS_SIMULATION)
+		rtos_posix_SkipIdleTime();
+#else
+		pause();
+#endif
+	}
+	(void)p;
+}
+// -------------------------------------------------------------------------------------------------------------------------------
+void rtos_TaskEntryPoint(void)
+{
+#if defined(RTOS_SMP)
+	rtos_posix_SMP_ExitCriticalSection(RTOS_OS_LOCK, 0);	// Unlock the OS, locked by whoever switched to this task.
+#else
+	RTOS_EnableInterrupts();
+#endif
+	rtos_RunTask();
+	while(1);
+}
+
+#if defined(RTOS_SMP)
+int RTOS_StartMultitasking(void)
+{
+	RTOS_CpuId cpu;
+
+	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
+
+	rtos_posix_CpuId = 0;
+	rtos_posix_CpuThreads[0] = pthread_self();
+	RTOS.Cpus = RTOS_CpuMask_AddCpu(0, 0);
+	*(RTOS_OS_LOCK) = 0;
+	RTOS_RestrictTaskToCpus(RTOS.TaskList[RTOS_Priority_Idle], RTOS_CpuMask_AddCpu(0, 0));
+	rtos_PrepareToStart();
+
+	for (cpu = 1; cpu < (RTOS_SMP_CPU_CORES); cpu++)
+	{
+		if (0 != pthread_create(&rtos_posix_CpuThreads[cpu], 0, &rtos_posix_SecondaryCpu, (void *)(uintptr_t)cpu))
+		{
+			return RTOS_ERROR_FAILED;
+		}
+	}
+
+	while (__atomic_load_n(&RTOS.Cpus, __ATOMIC_SEQ_CST) != (RTOS_CpuMask)((2ULL << ((RTOS_SMP_CPU_CORES) - 1)) - 1))
+	{
+		sched_yield();
+	}
+
+	rtos_LockCpuMutex(RTOS_OS_LOCK);
+	RTOS_CURRENT_TASK() =  RTOS.TaskList[RTOS_Priority_Idle];	// Default to the Idle task.
+	RTOS_TaskSet_AddMember(RTOS.RunningTasks, RTOS_Priority_Idle);
+	RTOS_CURRENT_TASK()->Cpu = 0;
+	rtos_Scheduler();						// Let the scheduler pick a higher priority task.
+	__atomic_store_n(&RTOS.IsRunning, 1, __ATOMIC_RELEASE);	// Indicate that the OS is up and running, releases the other CPUs.
+	rtos_posix_RunCpu();
+	return RTOS_ERROR_FAILED;					// We should never actually get here!
+}
+#else
+int RTOS_StartMultitasking(void)
+{
+	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
+
+	RTOS.CurrentTask =  RTOS.TaskList[RTOS_Priority_Idle];	// Default to the Idle task.
+	rtos_Scheduler();					// Let the scheduler pick a higher priority task.
+	RTOS.IsRunning = 1;					// Indicate that the OS is up and running.
+	setcontext((ucontext_t *)&(RTOS.CurrentTask->Context));	// The task enables interrupts in rtos_TaskEntryPoint().
+	return RTOS_ERROR_FAILED;				// We should never actually get here!
+}
+#endif
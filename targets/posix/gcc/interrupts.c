@@ -0,0 +1,259 @@
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <rtos.h>
+#include <rtos_internals.h>
+#include <board.h>
+#include "interrupts.h"
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// Interrupts are simulated with signals, the handlers run on the stack of the interrupted task.
+// When 'interrupts' are disabled the signal handler just records the interrupt as pending,
+// it is handled as soon as interrupts are enabled again (see rtos_restoreInterrupts()).
+// With RTOS_SMP the pending interrupts are per CPU thread, SIGALRM goes to whichever thread the kernel picks
+// and SIGUSR1 is the inter-processor interrupt sent by rtos_SignalCpus().
+#define RTOS_POSIX_INTERRUPT_TIMER	1
+#define RTOS_POSIX_INTERRUPT_SOFTWARE	2
+#define RTOS_POSIX_INTERRUPT_IPI	4
+
+static RTOS_POSIX_PER_CPU volatile uint32_t rtos_posix_PendingInterrupts;
+
+void (*Board_SoftwareInterruptHook)(void) = 0;
+
+extern void rtos_posix_SwitchTask(RTOS_Task *previous);
+
+// Run the handlers of all pending interrupts, called with interrupts disabled (and the OS locked if SMP is enabled).
+void rtos_posix_ServiceInterrupts(void)
+{
+	uint32_t pending;
+
+	while (0 != (pending = __atomic_exchange_n(&rtos_posix_PendingInterrupts, 0, __ATOMIC_SEQ_CST)))
+	{
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+		rtos_StampIsrEntry();
+#endif
+		rtos_posix_InterruptNesting++;
+
+		if (0 != (pending & (RTOS_POSIX_INTERRUPT_TIMER)))
+		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, SIGALRM, 0);
+			rtos_TimerTick();
+			RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, SIGALRM, 0);
+		}
+
+		if ((0 != (pending & (RTOS_POSIX_INTERRUPT_SOFTWARE))) && (0 != Board_SoftwareInterruptHook))
+		{
+			RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0, 0);
+			Board_SoftwareInterruptHook();
+			RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0, 0);
+		}
+
+		// RTOS_POSIX_INTERRUPT_IPI has no handler, the scheduler runs anyway.
+
+		rtos_posix_InterruptNesting--;
+	}
+}
+
+int rtos_posix_HasPendingInterrupts(void)
+{
+	return (0 != rtos_posix_PendingInterrupts);
+}
+
+#if defined(RTOS_SMP)
+// Handle all pending interrupts, called with interrupts disabled and the OS locked.
+// If the set of ready tasks or the task of this CPU has changed the CPUs that have to preempt their tasks are signalled,
+// a task preempted here may have to move to another CPU.
+static void rtos_posix_HandleInterrupts(void)
+{
+	RTOS_CpuId cpu = RTOS_CurrentCpu();
+	RTOS_Task *previous = RTOS.PerCpu[cpu].CurrentTask;
+	RTOS_TaskSet runnableTasks = RTOS.ReadyToRunTasks;
+	RTOS_CpuMask otherCpus;
+
+	rtos_posix_ServiceInterrupts();
+
+	rtos_posix_InterruptNesting++;
+	rtos_Scheduler();
+	rtos_posix_InterruptNesting--;
+
+	if ((runnableTasks != RTOS.ReadyToRunTasks) || (previous != RTOS.PerCpu[cpu].CurrentTask))
+	{
+		otherCpus = rtos_CpusToReschedule(cpu);
+
+		if (0 != otherCpus)
+		{
+			rtos_SignalCpus(otherCpus);
+		}
+	}
+
+	rtos_posix_SwitchTask(previous);
+}
+
+// Called when interrupts are enabled (again).
+// The task may come back on a different CPU thread, the lock is released by whichever CPU resumed it.
+void rtos_posix_DeliverPendingInterrupts(void)
+{
+	while (0 != rtos_posix_PendingInterrupts)
+	{
+		rtos_posix_InterruptsDisabled = 1;
+		rtos_LockCpuMutex(RTOS_OS_LOCK);
+		rtos_posix_HandleInterrupts();
+		rtos_UnlockCpuMutex(RTOS_OS_LOCK);
+		rtos_posix_InterruptsDisabled = 0;
+	}
+}
+#else
+// Handle all pending interrupts, called with interrupts disabled.
+static void rtos_posix_HandleInterrupts(void)
+{
+	RTOS_Task *previous = RTOS.CurrentTask;
+
+	rtos_posix_ServiceInterrupts();
+
+	if (rtos_IsRescheduleNeeded())
+	{
+		RTOS.InterruptNesting++;
+		rtos_Scheduler();
+		RTOS.InterruptNesting--;
+	}
+
+	rtos_posix_SwitchTask(previous);
+}
+
+// Called when interrupts are enabled (again).
+void rtos_posix_DeliverPendingInterrupts(void)
+{
+	while (0 != rtos_posix_PendingInterrupts)
+	{
+		rtos_posix_InterruptsDisabled = 1;
+		rtos_posix_HandleInterrupts();
+		rtos_posix_InterruptsDisabled = 0;
+	}
+}
+#endif
+
+static void rtos_posix_RaiseInterrupt(uint32_t interrupt)
+{
+	__atomic_fetch_or(&rtos_posix_PendingInterrupts, interrupt, __ATOMIC_SEQ_CST);
+
+	if (0 == rtos_posix_InterruptsDisabled)
+	{
+		rtos_posix_DeliverPendingInterrupts();
+	}
+}
+
+#if !defined(RTOS_SIMULATION)
+static void rtos_posix_TimerSignalHandler(int signal)
+{
+	int saved_errno = errno;
+
+	rtos_posix_RaiseInterrupt(RTOS_POSIX_INTERRUPT_TIMER);
+
+	errno = saved_errno;
+	(void)signal;
+}
+#endif
+
+#if defined(RTOS_SMP)
+static void rtos_posix_CpuSignalHandler(int signal)
+{
+	int saved_errno = errno;
+
+	rtos_posix_RaiseInterrupt(RTOS_POSIX_INTERRUPT_IPI);
+
+	errno = saved_errno;
+	(void)signal;
+}
+#endif
+
+// Unlike on real hardware the software interrupt is held off while interrupts are disabled.
+void Board_RaiseSoftwareInterrupt(void)
+{
+	rtos_posix_RaiseInterrupt(RTOS_POSIX_INTERRUPT_SOFTWARE);
+}
+
+#if defined(RTOS_SIMULATION)
+// Discrete-event simulation: there is no timer signal, virtual time only passes while a task 'works'
+// (Board_SimulateCpuBurst()) or when the idle task runs, in which case it jumps straight to the next wake-up.
+// Nothing depends on the timing of the host, every run of the same program produces the same results.
+
+// Model a CPU burst of the calling task, it lasts 'ticks' ticks of task time and can be preempted at every tick.
+// Must be called with interrupts enabled, the ticks would be lost otherwise.
+void Board_SimulateCpuBurst(RTOS_Time ticks)
+{
+	RTOS_ASSERT(0 == rtos_posix_InterruptsDisabled);
+
+	while (0 != ticks)
+	{
+		ticks--;
+		rtos_posix_RaiseInterrupt(RTOS_POSIX_INTERRUPT_TIMER);
+	}
+}
+
+// Called by the idle task, nothing else can run until a sleeping task wakes up.
+// If no task is sleeping nothing will ever happen again, that is the end of the simulation.
+void rtos_posix_SkipIdleTime(void)
+{
+	RTOS_Critical_State saved_state;
+	RTOS_Time ticks;
+
+	rtos_disableInterrupts(saved_state);
+#if defined(RTOS_SUPPORT_SLEEP)
+	ticks = rtos_IdleTicksBeforeWakeUp();
+#else
+	ticks = RTOS_TIMEOUT_FOREVER;
+#endif
+
+	if ((RTOS_TIMEOUT_FOREVER) == ticks)
+	{
+		rtos_restoreInterrupts(saved_state);
+		Board_Puts("\r\nSimulation finished, no task is left to wake up.\r\n");
+		exit(0);
+	}
+
+	RTOS.Time += ticks;
+	__atomic_fetch_or(&rtos_posix_PendingInterrupts, RTOS_POSIX_INTERRUPT_TIMER, __ATOMIC_SEQ_CST);
+	rtos_restoreInterrupts(saved_state);
+}
+#endif
+
+void InitInterrupts(void)
+{
+	struct sigaction action;
+
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;	// Tasks blocked in a system call (e.g. Board_Getc()) just carry on.
+
+#if !defined(RTOS_SIMULATION)
+	action.sa_handler = &rtos_posix_TimerSignalHandler;
+	sigaction(SIGALRM, &action, 0);
+#endif
+
+#if defined(RTOS_SMP)
+	action.sa_handler = &rtos_posix_CpuSignalHandler;
+	sigaction(RTOS_POSIX_CPU_SIGNAL, &action, 0);
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+extern void InitInterrupts(void);
+extern void rtos_posix_ServiceInterrupts(void);
+extern int rtos_posix_HasPendingInterrupts(void);
+#if defined(RTOS_SIMULATION)
+extern void rtos_posix_SkipIdleTime(void);
+#endif
+
+#if defined(RTOS_SMP)
+// The signal used as the inter-processor interrupt.
+#define RTOS_POSIX_CPU_SIGNAL SIGUSR1
+#define rtos_posix_InterruptNesting (RTOS.PerCpu[RTOS_CurrentCpu()].InterruptNesting)
+#else
+#define rtos_posix_InterruptNesting (RTOS.InterruptNesting)
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef RTOS_TARGET_H
+#define RTOS_TARGET_H
+
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#include <rtos_types.h>
+
+// A hosted port, the whole OS runs inside a single Linux process.
+// The timer interrupt is SIGALRM from setitimer(), tasks are ucontext contexts switched with swapcontext().
+// Disabling interrupts only sets a flag, a signal that arrives while the flag is set is remembered and
+// handled when the critical section is left. This keeps critical sections free of system calls.
+//
+// With RTOS_SMP each CPU is a thread (see cpu.c), and the 'interrupts disabled' flag is per thread.
+// Tasks migrate between the threads via swapcontext(), so every thread local access must be re-done after a task switch,
+// that only holds if the compiler does not cache the address of thread local variables (it does not on x86-64, %fs is used).
+
+#if defined(RTOS_SMP)
+#if !defined(__x86_64__)
+#error The SMP host port relies on %fs relative thread local storage, it only supports x86-64.
+#endif
+#if (RTOS_SMP_CPU_CORES) > 32
+#error RTOS_SMP_CPU_CORES must be <= 32 on this target.
+#endif
+#define RTOS_POSIX_PER_CPU __thread
+#else
+#define RTOS_POSIX_PER_CPU
+#endif
+
+extern RTOS_POSIX_PER_CPU volatile uint32_t rtos_posix_InterruptsDisabled;
+extern void rtos_posix_DeliverPendingInterrupts(void);
+extern void rtos_posix_InvokeScheduler(int yield);
+
+#define rtos_enableInterrupts() 						\
+	do { __asm__ volatile ("" : : : "memory"); rtos_posix_InterruptsDisabled = 0; rtos_posix_DeliverPendingInterrupts(); } while(0)
+
+#define rtos_disableInterrupts(SAVED) 						\
+	do { (SAVED) = rtos_posix_InterruptsDisabled; rtos_posix_InterruptsDisabled = 1; __asm__ volatile ("" : : : "memory"); } while(0)
+
+#define rtos_restoreInterrupts(SAVED) 						\
+	do { __asm__ volatile ("" : : : "memory"); rtos_posix_InterruptsDisabled = (SAVED); if (0 == (SAVED)) rtos_posix_DeliverPendingInterrupts(); } while(0)
+
+#define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
+
+#if defined(RTOS_SMP)
+extern RTOS_RegInt rtos_LockCpuMutex(volatile RTOS_CpuMutex *lock);
+extern RTOS_RegInt rtos_UnlockCpuMutex(volatile RTOS_CpuMutex *lock);
+
+#define RTOS_OS_LOCK  (&(RTOS.OSLock))
+
+extern RTOS_Critical_State rtos_posix_SMP_EnterCriticalSection(volatile RTOS_CpuMutex *lock);
+extern void rtos_posix_SMP_ExitCriticalSection(volatile RTOS_CpuMutex *lock, RTOS_Critical_State saved);
+
+#define rtos_TargetEnterCriticalSection(X)	(X) = rtos_posix_SMP_EnterCriticalSection(RTOS_OS_LOCK)
+#define rtos_TargetExitCriticalSection(X)	rtos_posix_SMP_ExitCriticalSection(RTOS_OS_LOCK, (X))
+#else
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#endif
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 == (X))
+#define RTOS_EnableInterrupts()		rtos_enableInterrupts()
+#define RTOS_DisableInterrupts()	do { RTOS_Critical_State rtos_tmp_saved; rtos_disableInterrupts(rtos_tmp_saved); (void)rtos_tmp_saved; } while(0)
+#define rtos_CLZ(X)			__builtin_clz(X)
+
+#define RTOS_INLINE static __inline__
+
+#define RTOS_INVOKE_SCHEDULER()	rtos_posix_InvokeScheduler(0)
+#define RTOS_INVOKE_YIELD()	rtos_posix_InvokeScheduler(1)
+
+extern uint64_t rtos_posix_ReadClock(void);
+#define RTOS_READ_CYCLE_COUNTER() rtos_posix_ReadClock()
+
+// Cache misses of the calling CPU thread (perf events), for benchmarks. Always 0 if the host does not allow perf events.
+extern uint32_t rtos_posix_ReadCacheMisses(void);
+#define RTOS_READ_CACHE_MISS_COUNTER() rtos_posix_ReadCacheMisses()
+
+#define RTOS_TASK_EXEC_LOCATION(TASK) ((uint32_t)0)
+
+#if defined(RTOS_SMP)
+extern __thread RTOS_CpuId rtos_posix_CpuId;
+
+#define RTOS_CurrentCpu() (rtos_posix_CpuId)
+
+#define RTOS_CpuMask_AddCpu(MASK, CPU) ((MASK) | (1UL << (CPU)))
+#define RTOS_CpuMask_RemoveCpu(MASK, CPU) ((MASK) & (~(1UL << (CPU))))
+#define RTOS_CpuMask_IsCpuIncluded(MASK, CPU) (0 != ((MASK) & (1UL << (CPU))))
+
+extern void rtos_SignalCpu(RTOS_CpuId cpu);
+extern void rtos_SignalCpus(RTOS_CpuMask cpus);
+#endif
+
+// Utility functions.
+#define RTOS_DEFAULT_IDLE_FUNCTION RTOS_DefaultIdleFunction
+extern void RTOS_DefaultIdleFunction(void *p);
+
+extern int RTOS_StartMultitasking(void);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef RTOS_TYPES_H
+#define RTOS_TYPES_H
+/*
+* Copyright (c) Andras Zsoter 2020.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+#include <stdint.h>
+#include <ucontext.h>
+
+// Interrupts are simulated with signals, this is the saved 'interrupts disabled' flag.
+typedef uint32_t RTOS_Critical_State;
+
+typedef uintptr_t RTOS_StackItem_t;
+
+// The 'cycle counter' is CLOCK_MONOTONIC in nanoseconds.
+#define RTOS_CYCLE_COUNTER_TYPE uint64_t
+
+// Each task runs in its own user context.
+#define RTOS_TARGET_SPECIFIC_TASK_DATA	ucontext_t Context;
+
+// Signal handlers run on the stack of the task they interrupt, and a signal frame alone can be a few kilobytes.
+// Tasks created with a smaller stack get one of this size allocated by the port instead.
+#if !defined(RTOS_POSIX_STACK_BYTES)
+#define RTOS_POSIX_STACK_BYTES (64 * 1024)
+#endif
+
+#define RTOS_INITIAL_STACK_DEPTH (sizeof(RTOS_StackItem_t))
+
+#if !defined( RTOS_FIND_HIGHEST)
+#define RTOS_FIND_HIGHEST(X) ((0U == (X)) ? ~(RTOS_TaskPriority)0 : (RTOS_TaskPriority)(31 - rtos_CLZ(X)))
+#define RTOS_TaskSet_NumberOfMembers(X) __builtin_popcount(X)
+#endif
+
+#define RTOS_MIN_STACK_SIZE ((RTOS_POSIX_STACK_BYTES) / sizeof(RTOS_StackItem_t))
+
+#define RTOS_CACHE_LINE_SIZE 64
+
+#if defined(RTOS_SMP)
+// Each CPU is a thread, a CPU mask has one bit per thread.
+typedef uint32_t RTOS_CpuId;
+#define RTOS_CPUID_NO_CPU ((RTOS_CpuId)(-1))
+typedef uint32_t RTOS_CpuMutex;
+typedef uint32_t RTOS_CpuMask;
+#endif
+
+#endif
@@ -109,26 +109,189 @@ char Board_Getc(void)
 	return c;
 }
 
-void Board_InitTimer(void)
+#define PIT_FREQUENCY			1193182U
+
+#define LAPIC_REG_EOI			0x0B0
+#define LAPIC_REG_SVR			0x0F0
+#define LAPIC_REG_LVT_TIMER		0x320
+#define LAPIC_REG_LVT_LINT0		0x350
+#define LAPIC_REG_LVT_LINT1		0x360
+#define LAPIC_REG_INITIAL_COUNT		0x380
+#define LAPIC_REG_CURRENT_COUNT		0x390
+#define LAPIC_REG_DIVIDE		0x3E0
+
+#define LAPIC_SVR_ENABLE		0x100
+#define LAPIC_LVT_MASKED		0x10000
+#define LAPIC_LVT_EXTINT		0x700
+#define LAPIC_LVT_NMI			0x400
+#define LAPIC_TIMER_PERIODIC		0x20000
+#define LAPIC_TIMER_TSC_DEADLINE	0x40000
+#define LAPIC_DIVIDE_BY_16		0x3
+
+#define LAPIC_SPURIOUS_VECTOR		0xFF
+#define TIMER_VECTOR			0x40
+
+#define MSR_APIC_BASE			0x1B
+#define MSR_APIC_BASE_ENABLE		0x800
+#define MSR_TSC_DEADLINE		0x6E0
+
+#define CPUID_1_EDX_TSC			(1U << 4)
+#define CPUID_1_EDX_MSR			(1U << 5)
+#define CPUID_1_EDX_APIC		(1U << 9)
+#define CPUID_1_ECX_TSC_DEADLINE	(1U << 24)
+
+uint64_t Board_TscPerSecond = 0;
+
+static volatile uint32_t *board_Lapic = 0;		// Local APIC registers (0 while the PIT drives the tick).
+static uint64_t board_TscPerTick = 0;			// Non-zero in TSC-deadline mode.
+static uint64_t board_TscDeadline;
+
+#define LAPIC(REG) (board_Lapic[(REG) / sizeof(uint32_t)])
+
+void Board_AcknowledgeTimer(void)
+{
+	uint64_t now;
+
+	if (0 == board_Lapic)
+	{
+		outb(0x20, 0x20);
+		return;
+	}
+
+	if (0 != board_TscPerTick)
+	{
+		// Stepping from the previous deadline keeps the tick free of drift.
+		// If we fell behind (e.g. stopped in a debugger) skip the missed ticks instead of firing them back to back.
+		board_TscDeadline += board_TscPerTick;
+		now = RTOS_READ_CYCLE_COUNTER();
+		if ((int64_t)(board_TscDeadline - now) <= 0)
+		{
+			board_TscDeadline = now + board_TscPerTick;
+		}
+		wrmsr(MSR_TSC_DEADLINE, board_TscDeadline);
+	}
+
+	LAPIC(LAPIC_REG_EOI) = 0;
+}
+
+// 64 by 32 bit division, there is no libgcc to do it for us.
+static uint64_t board_Divide(uint64_t n, uint32_t d)
+{
+	uint32_t hi = (uint32_t)(n >> 32);
+	uint32_t lo;
+	uint32_t r = hi % d;
+
+	__asm__ ("divl %4" : "=a" (lo), "=d" (r) : "a" ((uint32_t)n), "d" (r), "rm" (d));
+	return (((uint64_t)(hi / d)) << 32) | lo;
+}
+
+// Count TSC cycles (and local APIC timer counts if the APIC is in use) during 10ms measured by PIT channel 2.
+// Channel 2 is gated through port 0x61 and can be polled, so no interrupts are needed.
+static uint32_t board_Calibrate(void)
+{
+	const uint16_t count = (uint16_t)(PIT_FREQUENCY / 100);
+	uint8_t gate = inb(0x61);
+	uint64_t tsc;
+	uint32_t lapic = 0;
+
+	outb((uint8_t)((gate & ~0x02) | 0x01), 0x61);	// Gate high, speaker off.
+	outb(0xB0, 0x43);				// Channel 2, low/high byte, mode 0 (interrupt on terminal count).
+	outb((uint8_t)(count & 0xff), 0x42);
+	outb((uint8_t)((count >> 8) & 0xff), 0x42);
+
+	if (0 != board_Lapic)
+	{
+		LAPIC(LAPIC_REG_INITIAL_COUNT) = 0xFFFFFFFF;
+	}
+	tsc = RTOS_READ_CYCLE_COUNTER();
+
+	while (0 == (inb(0x61) & 0x20))		// OUT2 goes high at terminal count.
+	{
+	}
+
+	tsc = RTOS_READ_CYCLE_COUNTER() - tsc;
+	if (0 != board_Lapic)
+	{
+		lapic = 0xFFFFFFFF - LAPIC(LAPIC_REG_CURRENT_COUNT);
+		LAPIC(LAPIC_REG_INITIAL_COUNT) = 0;
+	}
+
+	outb(gate, 0x61);
+
+	Board_TscPerSecond = tsc * 100;
+	return lapic * 100;
+}
+
+static void board_InitPit(void)
 {
 	// Based on the description here:
 	// https://en.wikibooks.org/wiki/X86_Assembly/Programmable_Interval_Timer 
-	uint16_t div_factor = ((uint32_t)1193182) / (RTOS_TICKS_PER_SECOND);
+	uint16_t div_factor = (PIT_FREQUENCY) / (RTOS_TICKS_PER_SECOND);
 	outb(0x36, 0x43);
 	outb((uint8_t)(div_factor & 0xff), 0x40);
 	outb((uint8_t)((div_factor >> 8) & 0xff), 0x40);
 }
 
+// Must be called after InitInterrupts(), since it may have to mask the PIT in the 8259.
+void Board_InitTimer(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+
+#if (BOARD_USE_LAPIC_TIMER)
+	if ((CPUID_1_EDX_TSC | CPUID_1_EDX_MSR | CPUID_1_EDX_APIC) == (edx & (CPUID_1_EDX_TSC | CPUID_1_EDX_MSR | CPUID_1_EDX_APIC)))
+	{
+		uint64_t base = rdmsr(MSR_APIC_BASE);
+		uint32_t lapicPerSecond;
+
+		wrmsr(MSR_APIC_BASE, base | MSR_APIC_BASE_ENABLE);
+		board_Lapic = (volatile uint32_t *)(uint32_t)(base & 0xFFFFF000);	// Paging is off, MMIO is identity mapped.
+
+		// Software enable the APIC in virtual wire mode, so the 8259 (keyboard) still gets through.
+		LAPIC(LAPIC_REG_SVR) = LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR;
+		LAPIC(LAPIC_REG_LVT_LINT0) = LAPIC_LVT_EXTINT;
+		LAPIC(LAPIC_REG_LVT_LINT1) = LAPIC_LVT_NMI;
+		LAPIC(LAPIC_REG_DIVIDE) = LAPIC_DIVIDE_BY_16;
+		LAPIC(LAPIC_REG_LVT_TIMER) = LAPIC_LVT_MASKED | TIMER_VECTOR;
+
+		lapicPerSecond = board_Calibrate();
+
+		outb((uint8_t)(inb(0x21) | 0x01), 0x21);	// The PIT (IRQ0) would deliver extra ticks on the same vector.
+
+		if (0 != (ecx & CPUID_1_ECX_TSC_DEADLINE))
+		{
+			board_TscPerTick = board_Divide(Board_TscPerSecond, RTOS_TICKS_PER_SECOND);
+			LAPIC(LAPIC_REG_LVT_TIMER) = LAPIC_TIMER_TSC_DEADLINE | TIMER_VECTOR;
+			board_TscDeadline = RTOS_READ_CYCLE_COUNTER() + board_TscPerTick;
+			wrmsr(MSR_TSC_DEADLINE, board_TscDeadline);
+		}
+		else
+		{
+			LAPIC(LAPIC_REG_LVT_TIMER) = LAPIC_TIMER_PERIODIC | TIMER_VECTOR;
+			LAPIC(LAPIC_REG_INITIAL_COUNT) = lapicPerSecond / (RTOS_TICKS_PER_SECOND);
+		}
+		return;
+	}
+#endif
+
+	if (0 != (edx & CPUID_1_EDX_TSC))
+	{
+		(void)board_Calibrate();
+	}
+	board_InitPit();
+}
+
 // -------------------------------------------------------------------------------------------------
 int Board_HardwareInit(void)
 {
 	RTOS_DisableInterrupts();
 	VGA_Initialize();
-	Board_InitTimer();
 	Kbd_BufferHead = 0;
 	Kbd_BufferTail = 0;
 	KBD_Init();
 	InitInterrupts();
+	Board_InitTimer();
 	return 0;
 }
 
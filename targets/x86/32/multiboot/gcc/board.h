@@ -23,6 +23,8 @@
 *
 */
 
+#include <stdint.h>
+
 extern void Board_Putc(char c);
 extern void Board_Puts(const char *s);
 extern char Board_Getc(void);
@@ -31,6 +33,10 @@ extern void board_HandleIRQ(void);
 
 extern int Board_HardwareInit(void);
 
+// A software interrupt, the handler calls Board_SoftwareInterruptHook (if set) in interrupt context.
+extern void (*Board_SoftwareInterruptHook)(void);
+#define Board_RaiseSoftwareInterrupt() __asm__ volatile ("int $0x61" : : : "memory")
+
 // The X86 has separate instruction to access I/O ports (they are typically not memory mapped).
 // Here are some functions to access them.
 
@@ -48,4 +54,61 @@ static __inline__ void outb (unsigned char value, unsigned short int port)
   __asm__ volatile ("outb %b0,%w1": :"a" (value), "Nd" (port));
 }
 
+// CPU identification and model specific registers (Pentium or later, some late 486s).
+// CPUID exists if the ID flag (bit 21) of EFLAGS can be toggled.
+static __inline__ int has_cpuid(void)
+{
+  uint32_t before, after;
+
+  __asm__ volatile ("pushfl\n"
+		    "popl %0\n"
+		    "movl %0, %1\n"
+		    "xorl $0x200000, %1\n"
+		    "pushl %1\n"
+		    "popfl\n"
+		    "pushfl\n"
+		    "popl %1\n"
+		    "pushl %0\n"
+		    "popfl\n"
+		    :"=&r" (before), "=&r" (after): :"cc");
+  return 0 != ((before ^ after) & 0x200000);
+}
+
+// All registers read as 0 (no features) if the CPU has no CPUID instruction.
+static __inline__ void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+  if (!has_cpuid())
+  {
+    *eax = *ebx = *ecx = *edx = 0;
+    return;
+  }
+  __asm__ volatile ("cpuid":"=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx):"a" (leaf), "c" (0));
+}
+
+static __inline__ uint64_t rdmsr(uint32_t msr)
+{
+  uint64_t value;
+
+  __asm__ volatile ("rdmsr":"=A" (value):"c" (msr));
+  return value;
+}
+
+static __inline__ void wrmsr(uint32_t msr, uint64_t value)
+{
+  __asm__ volatile ("wrmsr": :"c" (msr), "A" (value));
+}
+
+// The tick comes from the local APIC timer when the CPU has one, in TSC-deadline mode if it is supported,
+// otherwise in periodic mode. The 8254 PIT is the fallback and the reference for calibration.
+// Define BOARD_USE_LAPIC_TIMER as 0 to always use the PIT.
+#if !defined(BOARD_USE_LAPIC_TIMER)
+#define BOARD_USE_LAPIC_TIMER 1
+#endif
+
+// TSC frequency measured against the PIT at start up (see RTOS_READ_CYCLE_COUNTER()).
+extern uint64_t Board_TscPerSecond;
+
+// End of interrupt for the timer (and re-arming the deadline in TSC-deadline mode).
+extern void Board_AcknowledgeTimer(void);
+
 #endif
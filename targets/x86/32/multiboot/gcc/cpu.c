@@ -38,6 +38,9 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 	// The stack pointer can legitimately be 0 at this point if the task is initialized as the 'current thread of execution'.
 	if (0 != task->SP0)
 	{
+#if defined(RTOS_INCLUDE_STACK_CHECK)
+		rtos_PaintStack(task, stackCapacity);
+#endif
 		task->SP = (void *)(((char *)task->SP0) + (sizeof(RTOS_StackItem_t) * stackCapacity) - (RTOS_INITIAL_STACK_DEPTH));
 		sp = (rtos_StackFrame *)(task->SP);
 
@@ -55,8 +58,186 @@ void rtos_TargetInitializeTask(RTOS_Task *task, unsigned long stackCapacity)
 		sp->esi = 0x11111111;
 	}
 
+#if (RTOS_X86_LAZY_FPU)
+	task->FpuContext.valid = 0;
+	task->FpuContext.disabled = 0;
+	rtos_x86_ReleaseFpu(task);
+#endif
 }
 // -------------------------------------------------------------------------------------------------------------------------------
+#if (RTOS_X86_LAZY_FPU)
+#define CR0_MP	0x00000002	/* Monitor coprocessor: WAIT/FWAIT honour TS. */
+#define CR0_EM	0x00000004	/* Emulation: every FPU instruction raises #NM. */
+#define CR0_TS	0x00000008	/* Task switched: the next FPU instruction raises #NM. */
+#define CR0_NE	0x00000020	/* Native FPU error reporting (#MF). */
+#define CR4_OSFXSR	0x00000200	/* FXSAVE/FXRSTOR save the SSE state, SSE instructions are enabled. */
+#define CR4_OSXMMEXCPT	0x00000400	/* Unmasked SSE exceptions raise #XM. */
+
+#define CPUID_FXSR	(1U << 24)
+#define CPUID_SSE	(1U << 25)
+
+RTOS_Task *rtos_x86_FpuOwner = 0;			// The task whose registers are in the FPU right now.
+static uint32_t rtos_x86_Fxsr = 0;			// The CPU has FXSAVE/FXRSTOR.
+static uint32_t rtos_x86_Sse = 0;			// The CPU has SSE (and the OS has enabled it).
+
+static void rtos_x86_InitFpu(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t cr0;
+	uint32_t cr4;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	rtos_x86_Fxsr = (0 != (edx & CPUID_FXSR));
+	rtos_x86_Sse = rtos_x86_Fxsr && (0 != (edx & CPUID_SSE));
+
+	if (rtos_x86_Fxsr)
+	{
+		__asm__ volatile ("movl %%cr4, %0" : "=r" (cr4));
+		cr4 |= CR4_OSFXSR;
+		if (rtos_x86_Sse)
+		{
+			cr4 |= CR4_OSXMMEXCPT;
+		}
+		__asm__ volatile ("movl %0, %%cr4" : : "r" (cr4));
+	}
+
+	__asm__ volatile ("movl %%cr0, %0" : "=r" (cr0));
+	cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+	__asm__ volatile ("movl %0, %%cr0" : : "r" (cr0));
+	__asm__ volatile ("fninit");
+
+	// Nobody owns the FPU yet, so the first task to use it has to trap.
+	rtos_x86_FpuOwner = 0;
+	__asm__ volatile ("movl %0, %%cr0" : : "r" (cr0 | CR0_TS));
+}
+
+// Called on the task switch path of the trap exit (see interrupts.c) after RTOS.CurrentTask has been switched.
+// CR0 is only written when TS actually has to change, so switching between tasks that do not use the FPU costs a CR0 read.
+void rtos_x86_SwitchFpu(void)
+{
+	uint32_t cr0;
+
+	__asm__ volatile ("movl %%cr0, %0" : "=r" (cr0));
+
+	if (RTOS.CurrentTask == rtos_x86_FpuOwner)
+	{
+		if (0 != (cr0 & CR0_TS))
+		{
+			__asm__ volatile ("clts");
+		}
+	}
+	else
+	{
+		if (0 == (cr0 & CR0_TS))
+		{
+			__asm__ volatile ("movl %0, %%cr0" : : "r" (cr0 | CR0_TS));
+		}
+	}
+}
+
+// Device not available (#NM): the current task wants the FPU, give it its own registers.
+// Interrupts are disabled (interrupt gate).
+uint32_t rtos_x86_FpuTrap(void)
+{
+	RTOS_Task *task = RTOS.CurrentTask;
+	uint8_t *area;
+
+	if ((0 != RTOS.InterruptNesting) || (0 == task) || task->FpuContext.disabled)
+	{
+		return 0;
+	}
+
+	__asm__ volatile ("clts");
+
+	if (task == rtos_x86_FpuOwner)
+	{
+		return 1;
+	}
+
+	if (0 != rtos_x86_FpuOwner)
+	{
+		area = (uint8_t *)(rtos_x86_FpuOwner->FpuContext.area);
+		if (rtos_x86_Fxsr)
+		{
+			__asm__ volatile ("fxsave (%0)" : : "r" (area) : "memory");
+		}
+		else
+		{
+			__asm__ volatile ("fnsave (%0)" : : "r" (area) : "memory");
+		}
+		rtos_x86_FpuOwner->FpuContext.valid = 1;
+	}
+
+	area = (uint8_t *)(task->FpuContext.area);
+	if (task->FpuContext.valid)
+	{
+		if (rtos_x86_Fxsr)
+		{
+			__asm__ volatile ("fxrstor (%0)" : : "r" (area) : "memory");
+		}
+		else
+		{
+			__asm__ volatile ("frstor (%0)" : : "r" (area) : "memory");
+		}
+	}
+	else
+	{
+		// First use, start from a clean FPU (and the default MXCSR: all SSE exceptions masked).
+		__asm__ volatile ("fninit");
+		if (rtos_x86_Sse)
+		{
+			uint32_t mxcsr = 0x1F80;
+			__asm__ volatile ("ldmxcsr %0" : : "m" (mxcsr));
+		}
+	}
+
+	rtos_x86_FpuOwner = task;
+
+	return 1;
+}
+
+// Called inside a critical section.
+void rtos_x86_ReleaseFpu(RTOS_Task *task)
+{
+	if (task == rtos_x86_FpuOwner)
+	{
+		rtos_x86_FpuOwner = 0;
+	}
+}
+
+RTOS_RegInt RTOS_SetTaskUsesFpu(RTOS_Task *task, RTOS_RegInt usesFpu)
+{
+	RTOS_SavedCriticalState(saved_state);
+
+#if defined(RTOS_USE_ASSERTS)
+	RTOS_ASSERT(0 != task);
+#endif
+
+#if !defined(RTOS_DISABLE_RUNTIME_CHECKS)
+	if (0 == task)
+	{
+		return RTOS_ERROR_OPERATION_NOT_PERMITTED;
+	}
+#endif
+
+	RTOS_EnterCriticalSection(saved_state);
+	task->FpuContext.disabled = !usesFpu;
+
+	if ((!usesFpu) && (task == rtos_x86_FpuOwner))
+	{
+		rtos_x86_FpuOwner = 0;
+
+		if (task == RTOS_CURRENT_TASK())
+		{
+			rtos_x86_SwitchFpu();
+		}
+	}
+	RTOS_ExitCriticalSection(saved_state);
+
+	return RTOS_OK;
+}
+#endif
+// -------------------------------------------------------------------------------------------------------------------------------
 void RTOS_DefaultIdleFunction(void *p)
 {
 	while(1)
@@ -76,6 +257,9 @@ int RTOS_StartMultitasking(void)
 {
 	RTOS_ASSERT(0 != RTOS.TaskList[RTOS_Priority_Idle]);
 
+#if (RTOS_X86_LAZY_FPU)
+	rtos_x86_InitFpu();
+#endif
 	RTOS.CurrentTask =  RTOS.TaskList[RTOS_Priority_Idle];	// Default to the Idle task.
 	rtos_Scheduler();					// Let the scheduler pick a higher priority task.
 	// BTW: There is no need to enable interrupts here, 
@@ -102,49 +102,86 @@ void Invoke_Scheduler_Handler(uint32_t select)
 	RTOS.InterruptNesting--;
 }
 
+// Trap entry and exit.
+// On entry only the registers a C function is allowed to clobber are pushed (in the same order as PUSHA would push them)
+// together with the current task. If the handler has not switched tasks (most interrupts) they are simply popped on the way out.
+// Otherwise the rest of the PUSHA frame is completed, its address is stored as the stack pointer of the interrupted task
+// (the first field of the task structure), and the new task is resumed from its own frame.
+#define TRAP_ENTRY							\
+	"cli\n"								\
+	"pushl %eax\n"							\
+	"pushl %ecx\n"							\
+	"pushl %edx\n"							\
+	"movl (RTOS), %ecx\n"						\
+	"pushl %ecx\n"
+
+#if (RTOS_X86_LAZY_FPU)
+#define TRAP_SWITCH_FPU "call rtos_x86_SwitchFpu\n"
+#else
+#define TRAP_SWITCH_FPU
+#endif
+
+#define TRAP_EXIT							\
+	"popl %ecx\n"							\
+	"cmpl (RTOS), %ecx\n"						\
+	"jne 1f\n"							\
+	"popl %edx\n"							\
+	"popl %ecx\n"							\
+	"popl %eax\n"							\
+	"iret\n"							\
+	"1:\n"								\
+	"pushl %ebx\n"							\
+	"pushl %esp\n"							\
+	"pushl %ebp\n"							\
+	"pushl %esi\n"							\
+	"pushl %edi\n"							\
+	"movl %esp, (%ecx)\n"						\
+	TRAP_SWITCH_FPU							\
+	"movl (RTOS), %ebx\n"						\
+	"movl (%ebx), %esp\n"						\
+	"popa\n"							\
+	"iret\n"
+
 extern void Invoke_Scheduler_Wrapper(void);
 __asm__(
 	"Invoke_Scheduler_Wrapper:\n"
-	"cli\n"
-	"pusha\n"
-	"movl (RTOS), %ebx\n"
-	"movl %esp, (%ebx)\n"
+	TRAP_ENTRY
 	"pushl %eax\n"
 	"call Invoke_Scheduler_Handler\n"
-	"movl (RTOS), %ebx\n"
-	"movl (%ebx), %esp\n"
-	"popa\n"
-	"iret\n"
+	"addl $4, %esp\n"
+	TRAP_EXIT
 );
 
 #define INT_WRAPPER(WRAPPER_NAME, WRAPPED_FUNCTION)			\
 	extern void (WRAPPER_NAME)(void);				\
 	__asm__ (							\
 	#WRAPPER_NAME ":\n"						\
-	"cli\n"								\
-	"pusha\n"							\
-	"movl (RTOS), %ebx\n"						\
-	"movl %esp, (%ebx)\n"						\
+	TRAP_ENTRY							\
 	"call " #WRAPPED_FUNCTION "\n"					\
-	"movl (RTOS), %ebx\n"						\
-	"movl (%ebx), %esp\n"						\
-	"popa\n"							\
-	"iret\n"							\
+	TRAP_EXIT							\
 )
 
 // Handle timer interrupts.
 void Timer_Interrupt_Handler(void) 
 {
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
 	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0x40, 0);
 	rtos_TimerTick();
-	rtos_Scheduler();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0x40, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
 #if defined(DEBUG_INTERRUPTS)
 	Board_Putc('+');
 	Board_Putc(' ');
 	Board_Putc('i');
 	PrintHex(RTOS.InterruptNesting);
 #endif
-	outb(0x20, 0x20);
+	Board_AcknowledgeTimer();
 	RTOS.InterruptNesting--;
 }
 
@@ -185,6 +222,11 @@ KBD_Event_t KBD_Handler(void)
 void Kbd_Interrupt_Handler(void)
 {
 	KBD_Event_t event;
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
+	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0x41, 0);
 	event = KBD_Handler();
 	Board_KeyboardHandler(event);
 	
@@ -194,8 +236,35 @@ void Kbd_Interrupt_Handler(void)
 		VGA_Cls();
 	}
 #endif
-	rtos_Scheduler();
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0x41, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
 	outb(0x20, 0x20);
+	RTOS.InterruptNesting--;
+}
+
+// Software interrupt (INT 0x61) for testing and benchmarking interrupt processing, see Board_RaiseSoftwareInterrupt().
+void (*Board_SoftwareInterruptHook)(void) = 0;
+
+void Software_Interrupt_Handler(void)
+{
+#if defined(RTOS_INCLUDE_WAKEUP_LATENCY)
+	rtos_StampIsrEntry();
+#endif
+	RTOS.InterruptNesting++;
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_ENTER, 0x61, 0);
+	if (0 != Board_SoftwareInterruptHook)
+	{
+		Board_SoftwareInterruptHook();
+	}
+	RTOS_TRACE(RTOS_TRACE_EVENT_ISR_EXIT, 0x61, 0);
+	if (rtos_IsRescheduleNeeded())
+	{
+		rtos_Scheduler();
+	}
+	RTOS.InterruptNesting--;
 }
 
 // Divide by zero -- it seems to have happened, so watch for it.
@@ -214,16 +283,67 @@ void Divide_by_Zero_Handler(void)
 	while(1);
 }
 
+#if (RTOS_X86_LAZY_FPU)
+// Device not available (#NM) -- a task touched the FPU while CR0.TS was set.
+// This never switches tasks, so only the scratch registers are saved.
+void Device_Not_Available_Handler(void)
+{
+	if (0 != rtos_x86_FpuTrap())
+	{
+		return;
+	}
+
+	// An interrupt handler or a task that has opted out of the FPU (see RTOS_SetTaskUsesFpu()).
+	Board_Puts("FPU used by task@"); PrintHex(RTOS_TASK_EXEC_LOCATION(RTOS.CurrentTask));
+#if defined(RTOS_TASK_NAME_LENGTH)
+	Board_Puts((const char *)(RTOS.CurrentTask->TaskName));
+#else
+	PrintHex((uint32_t)(RTOS.CurrentTask));
+#endif
+	Board_Putc(' ');
+	Board_Putc('I');
+	PrintHex(RTOS.InterruptNesting);
+	MAGIC_BREAKPOINT();
+	while(1);
+}
+
+extern void Device_Not_Available_Wrapper(void);
+__asm__(
+	"Device_Not_Available_Wrapper:\n"
+	"pushl %eax\n"
+	"pushl %ecx\n"
+	"pushl %edx\n"
+	"call Device_Not_Available_Handler\n"
+	"popl %edx\n"
+	"popl %ecx\n"
+	"popl %eax\n"
+	"iret\n"
+);
+#endif
+
+// Spurious interrupt from the local APIC, it must not be acknowledged.
+extern void Spurious_Interrupt_Wrapper(void);
+__asm__(
+	"Spurious_Interrupt_Wrapper:\n"
+	"iret\n"
+);
+
 INT_WRAPPER(Timer_Interrupt_Wrapper, Timer_Interrupt_Handler);
 INT_WRAPPER(Kbd_Interrupt_Wrapper, Kbd_Interrupt_Handler);
 INT_WRAPPER(Divide_by_Zero_Wrapper, Divide_by_Zero_Handler);
+INT_WRAPPER(Software_Interrupt_Wrapper, Software_Interrupt_Handler);
 
 void InitInterrupts(void)
 {
 	Patch_IDT_Entry(0x00, (uint32_t)&Divide_by_Zero_Wrapper);
+#if (RTOS_X86_LAZY_FPU)
+	Patch_IDT_Entry(0x07, (uint32_t)&Device_Not_Available_Wrapper);
+#endif
 	Patch_IDT_Entry(0x40, (uint32_t)&Timer_Interrupt_Wrapper);
 	Patch_IDT_Entry(0x41, (uint32_t)&Kbd_Interrupt_Wrapper);
 	Patch_IDT_Entry(0x60, (uint32_t)&Invoke_Scheduler_Wrapper);
+	Patch_IDT_Entry(0x61, (uint32_t)&Software_Interrupt_Wrapper);
+	Patch_IDT_Entry(0xFF, (uint32_t)&Spurious_Interrupt_Wrapper);
 
 	// ---------------------------------------------------------
 	outb(0x11, 0x20);	// ICW1 -- Begin initialization.
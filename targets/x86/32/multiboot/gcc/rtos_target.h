@@ -44,8 +44,9 @@
 
 #define RTOS_SavedCriticalState(X) 	RTOS_Critical_State X
 
-#define RTOS_EnterCriticalSection(X)	rtos_disableInterrupts(X)
-#define RTOS_ExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define rtos_TargetEnterCriticalSection(X)	rtos_disableInterrupts(X)
+#define rtos_TargetExitCriticalSection(X)	rtos_restoreInterrupts(X)
+#define RTOS_CRITICAL_STATE_WAS_ENABLED(X)	(0 != ((X) & 0x200))	/* IF flag. */
 #define RTOS_EnableInterrupts()		rtos_enableInterrupts()
 #define RTOS_DisableInterrupts()	do { RTOS_Critical_State rtos_tmp_saved; rtos_disableInterrupts(rtos_tmp_saved); } while(0)
 #define rtos_CLZ(X)			__builtin_clzl(X)
@@ -60,8 +61,23 @@
 #define RTOS_INVOKE_YIELD() __asm__ volatile ( "pushf\n pushl %eax\n movl $1,%eax\n int $0x60\n popl %eax\n popf\n" ) 
 #endif
 
+// Read the time stamp counter (Pentium or later).
+#define RTOS_READ_CYCLE_COUNTER() ({ uint64_t rtos_tsc; __asm__ volatile ("rdtsc" : "=A" (rtos_tsc)); rtos_tsc; })
+
 #define RTOS_TASK_EXEC_LOCATION(TASK) ((rtos_StackFrame *)((TASK)->SP))->eip
 
+#if (RTOS_X86_LAZY_FPU)
+// Tasks may use the FPU by default, a task that never does can opt out, then any FPU/SSE instruction it executes is fatal.
+extern RTOS_RegInt RTOS_SetTaskUsesFpu(RTOS_Task *task, RTOS_RegInt usesFpu);
+
+// Called from the #NM handler, returns 0 if the trap cannot be serviced.
+extern uint32_t rtos_x86_FpuTrap(void);
+
+// Forget the FPU registers of a task that is going away.
+extern void rtos_x86_ReleaseFpu(RTOS_Task *task);
+#define rtos_TargetTaskKilled(TASK) rtos_x86_ReleaseFpu(TASK)
+#endif
+
 // Utility functions.
 #define RTOS_DEFAULT_IDLE_FUNCTION RTOS_DefaultIdleFunction
 extern void RTOS_DefaultIdleFunction(void *p);
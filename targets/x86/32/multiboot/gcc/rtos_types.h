@@ -30,6 +30,9 @@ typedef uint32_t RTOS_Critical_State;
 
 typedef uint32_t RTOS_StackItem_t;
 
+// The time stamp counter is 64 bits wide.
+#define RTOS_CYCLE_COUNTER_TYPE uint64_t
+
 struct rtos_StackFrame
 {
 	RTOS_StackItem_t edi;
@@ -47,6 +50,28 @@ struct rtos_StackFrame
 
 typedef struct rtos_StackFrame rtos_StackFrame;
 
+// Lazy x87/SSE context switching.
+// The FPU registers are not part of the task's stack frame. CR0.TS is set whenever a task other than the last FPU user is
+// switched in, the first FPU/SSE instruction that task executes raises #NM (device not available), and the handler swaps
+// the registers (see rtos_x86_FpuTrap()). Tasks that never use floating point or SSE never pay for it.
+// This is opt-in (like RTOS_ARM_LAZY_NEON): every task gets a 512 byte save area and interrupt handlers must not
+// use the FPU at all, an FPU/SSE instruction in an ISR is fatal. Without it the FPU state is shared by all tasks.
+#if !defined(RTOS_X86_LAZY_FPU)
+#	define RTOS_X86_LAZY_FPU 0
+#endif
+
+#if (RTOS_X86_LAZY_FPU)
+// The FPU registers of a task, only written when another task needs the unit.
+struct rtos_FpuContext
+{
+	uint8_t  area[512] __attribute__((aligned(16)));	// FXSAVE image (FNSAVE image on CPUs without FXSR).
+	uint32_t valid;			// The area holds the registers of the task, otherwise they start out FNINIT-ed.
+	uint32_t disabled;		// The task never uses the FPU (see RTOS_SetTaskUsesFpu()).
+};
+
+#define RTOS_TARGET_SPECIFIC_TASK_DATA	struct rtos_FpuContext FpuContext;
+#endif
+
 // This is needed when we create stack frames for tasks that haven't started yet.
 #define RTOS_INITIAL_STACK_DEPTH (sizeof(rtos_StackFrame) + 8)
 
@@ -63,5 +88,7 @@ typedef struct rtos_StackFrame rtos_StackFrame;
 
 #define RTOS_MIN_STACK_SIZE 512 /* What is the real number? */
 
+#define RTOS_CACHE_LINE_SIZE 64
+
 #endif
 